@@ -0,0 +1,197 @@
+#include "checkpoint.h"
+#include <fstream>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+
+namespace {
+    const char magic[4] = {'L', 'M', 'C', 'K'};
+    const uint32_t version = 3;
+
+    void write_number(std::ostream& out, uint64_t n) {
+        out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+    }
+
+    uint64_t read_number(std::istream& in) {
+        uint64_t n;
+        if (!in.read(reinterpret_cast<char*>(&n), sizeof(n)))
+            throw std::runtime_error("Unexpected end of checkpoint");
+        return n;
+    }
+
+    void write_string(std::ostream& out, const std::string& s) {
+        write_number(out, s.size());
+        out.write(s.data(), s.size());
+    }
+
+    std::string read_string(std::istream& in) {
+        uint64_t n = read_number(in);
+        // identifiers are short, a big size means a corrupted file
+        if (n > (1 << 20))
+            throw std::runtime_error("Malformed checkpoint");
+        std::string s(n, '\0');
+        if (!in.read(s.data(), n))
+            throw std::runtime_error("Unexpected end of checkpoint");
+        return s;
+    }
+}
+
+
+uint64_t Lambda::Checkpoint::hash_program(const std::string& program) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (unsigned char c : program)
+        h = (h ^ c) * 0x100000001b3ull;
+    return h;
+}
+
+
+Lambda::Checkpoint::ContextData::ContextData(const Context& context) :
+    identifiers{context.get_identifiers()}
+{
+    for (auto& [identifier, t] : context.get_definitions())
+        definitions.push_back({identifier, FlatTerm(*t)});
+}
+
+
+void Lambda::Checkpoint::ContextData::restore(Context& context) const {
+    // pushed in order, so the indices stay the same
+    for (auto& identifier : identifiers)
+        context.push_identifier(identifier);
+    for (auto& [identifier, t] : definitions)
+        context.define(identifier, t.to_term(), false);
+}
+
+
+void Lambda::Checkpoint::write(std::ostream& out) const {
+    assert(context != nullptr);
+    out.write(magic, sizeof(magic));
+    out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+
+    write_number(out, program);
+    write_number(out, strategy);
+    write_number(out, max_steps);
+    write_number(out, optimized);
+    write_number(out, line_number);
+    write_number(out, steps);
+    write_number(out, next_binding);
+
+    write_number(out, context->identifiers.size());
+    for (auto& identifier : context->identifiers)
+        write_string(out, identifier);
+    write_number(out, context->definitions.size());
+    for (auto& [identifier, t] : context->definitions) {
+        write_string(out, identifier);
+        t.write(out);
+    }
+
+    write_number(out, term.size() > 0);
+    if (term.size() > 0)
+        term.write(out);
+}
+
+
+Lambda::Checkpoint Lambda::Checkpoint::read(std::istream& in) {
+    char m[sizeof(magic)];
+    uint32_t v;
+    if (!in.read(m, sizeof(m)) || !std::equal(m, m + sizeof(m), magic))
+        throw std::runtime_error("Not a checkpoint");
+    if (!in.read(reinterpret_cast<char*>(&v), sizeof(v)) || v != version)
+        throw std::runtime_error("Unsupported checkpoint version");
+
+    Checkpoint checkpoint;
+    checkpoint.program = read_number(in);
+    uint64_t strategy = read_number(in);
+    if (strategy != PARALLEL && strategy != NORMAL)
+        throw std::runtime_error("Malformed checkpoint");
+    checkpoint.strategy = static_cast<Strategy>(strategy);
+    checkpoint.max_steps = read_number(in);
+    uint64_t optimized = read_number(in);
+    if (optimized > 1)
+        throw std::runtime_error("Malformed checkpoint");
+    checkpoint.optimized = optimized;
+    checkpoint.line_number = read_number(in);
+    checkpoint.steps = read_number(in);
+    checkpoint.next_binding = read_number(in);
+
+    auto context = std::make_shared<ContextData>();
+    uint64_t identifiers = read_number(in);
+    for (uint64_t i = 0; i < identifiers; ++i)
+        context->identifiers.push_back(read_string(in));
+    uint64_t definitions = read_number(in);
+    for (uint64_t i = 0; i < definitions; ++i) {
+        std::string identifier = read_string(in);
+        context->definitions.push_back({identifier, FlatTerm::read(in)});
+    }
+    checkpoint.context = context;
+
+    if (read_number(in))
+        checkpoint.term = FlatTerm::read(in);
+    return checkpoint;
+}
+
+
+Lambda::Checkpointer::Checkpointer(const std::string& path, double interval) :
+    path{path},
+    interval{std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(interval))},
+    next{std::chrono::steady_clock::now() + this->interval},
+    writer{&Checkpointer::work, this}
+{
+}
+
+
+Lambda::Checkpointer::~Checkpointer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_one();
+    writer.join();
+}
+
+
+void Lambda::Checkpointer::save(Checkpoint checkpoint) {
+    next = std::chrono::steady_clock::now() + interval;
+    std::lock_guard<std::mutex> lock(mutex);
+    pending = std::move(checkpoint);
+    changed.notify_one();
+}
+
+
+bool Lambda::Checkpointer::load(const std::string& path, Checkpoint& checkpoint) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.good())
+        return false;
+    checkpoint = Checkpoint::read(in);
+    return true;
+}
+
+
+void Lambda::Checkpointer::work() {
+    while (true) {
+        Checkpoint checkpoint;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]() { return stopping || pending; });
+            if (!pending)
+                return;
+            checkpoint = std::move(*pending);
+            pending.reset();
+        }
+
+        // rename replaces the old checkpoint atomically
+        std::string tmp = path + ".tmp";
+        {
+            std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+            checkpoint.write(out);
+            out.flush();
+            if (!out.good()) {
+                std::cerr << "Couldn't write checkpoint '" << tmp << "'" << std::endl;
+                continue;
+            }
+        }
+        if (std::rename(tmp.c_str(), path.c_str()) != 0)
+            std::cerr << "Couldn't write checkpoint '" << path << "'" << std::endl;
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <optional>
+#include "flat.h"
+#include "context.h"
+#include "lambda.h"
+
+namespace Lambda {
+    // The state of a program run, see run.
+    struct Checkpoint {
+        // a Context in flat form
+        struct ContextData {
+            explicit ContextData(const Context& context);
+            ContextData() = default;
+            // context must be empty
+            // the definitions aren't optimized again
+            void restore(Context& context) const;
+
+            std::vector<std::string> identifiers;
+            std::vector<std::pair<std::string, FlatTerm>> definitions;
+        };
+
+        // what produced it, a checkpoint only resumes the same run
+        uint64_t program = 0;
+        Strategy strategy = PARALLEL;
+        size_t max_steps = 0;
+        // the context had an optimizer, its definitions are stored optimized
+        bool optimized = false;
+
+        // the lines before it are done
+        size_t line_number = 1;
+        // steps done on the line
+        size_t steps = 0;
+        // of the printer, see Printer::get_next_binding
+        size_t next_binding = 0;
+        // shared by the checkpoints of one line, it doesn't change during evaluation
+        std::shared_ptr<const ContextData> context;
+        // the line's term so far, empty if the line hasn't started
+        FlatTerm term;
+
+        static uint64_t hash_program(const std::string& program);
+
+        // native byte order
+        void write(std::ostream& out) const;
+        // throws std::runtime_error on malformed input
+        static Checkpoint read(std::istream& in);
+    };
+
+    // Saves checkpoints to a file on a background thread.
+    // The file is replaced atomically, so it always holds a whole checkpoint.
+    class Checkpointer {
+    public:
+        // interval in seconds
+        Checkpointer(const std::string& path, double interval);
+        // writes the last checkpoint before returning
+        ~Checkpointer();
+
+        // cheap enough to call after every step
+        bool due() const { return std::chrono::steady_clock::now() >= next; }
+        // Queues a checkpoint, replacing one that wasn't written yet.
+        void save(Checkpoint checkpoint);
+
+        // returns false if there's no checkpoint at path
+        // throws std::runtime_error if it's malformed
+        static bool load(const std::string& path, Checkpoint& checkpoint);
+
+        Checkpointer(const Checkpointer& o) = delete;
+        void operator=(const Checkpointer& o) = delete;
+    private:
+        void work();
+
+        std::string path;
+        std::chrono::steady_clock::duration interval;
+        std::chrono::steady_clock::time_point next;
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::optional<Checkpoint> pending;
+        bool stopping = false;
+        std::thread writer;
+    };
+}
+
+#endif
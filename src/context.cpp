@@ -1,5 +1,12 @@
 #include "context.h"
 #include "term.h"
+#include "flat.h"
+
+Context::Context(const Context* parent) :
+    parent{parent},
+    identifiers{parent->identifiers}
+{
+}
 
 const std::string& Context::get_identifier(size_t index) const {
     assert(index < identifiers.size());
@@ -12,7 +19,7 @@ size_t Context::push_identifier(const std::string& identifier) {
             return i;
     }
 
-    if (definitions.find(identifier) != definitions.end())
+    if (find_definition(identifier) != nullptr)
         throw std::runtime_error("'" + identifier + "' is taken");
 
     identifiers.push_back(identifier);
@@ -20,20 +27,42 @@ size_t Context::push_identifier(const std::string& identifier) {
 }
 
 
-std::shared_ptr<Term> Context::get_definition(const std::string& identifier) const {
+const Term* Context::find_definition(const std::string& identifier) const {
+    for (const Context* c = this; c != nullptr; c = c->parent) {
+        auto iter = c->definitions.find(identifier);
+        if (iter != c->definitions.end())
+            return iter->second.get();
+    }
+    return nullptr;
+}
+
+
+Ref<Term> Context::get_definition(const std::string& identifier) const {
     auto iter = definitions.find(identifier);
-    if (iter == definitions.end())
+    if (iter != definitions.end())
+        return iter->second;
+
+    iter = imported.find(identifier);
+    if (iter != imported.end())
+        return iter->second;
+
+    const Term* t = parent ? parent->find_definition(identifier) : nullptr;
+    if (t == nullptr)
         return nullptr;
-    return iter->second;
+    return imported[identifier] = FlatTerm(*t).to_term();
 }
 
 
-void Context::define(const std::string& identifier, std::shared_ptr<Term> t) {
+void Context::define(const std::string& identifier, Ref<Term> t, bool optimize) {
     for (size_t i = 0; i < identifiers.size(); ++i) {
         if (identifiers[i] == identifier)
             throw std::runtime_error("'" + identifier + "' is taken");
     }
 
+    if (optimizer && optimize)
+        t = optimizer(identifier, std::move(t));
+
+    imported.erase(identifier);
     definitions[identifier] = t;
 }
 
@@ -3,24 +3,51 @@
 
 #include <vector>
 #include <map>
-#include <memory>
+#include <string>
+#include <functional>
+#include "ref.h"
 #include <cassert>
 
 class Term;
 
 class Context {
 public:
+    Context() = default;
+    // A scratch context on top of parent, which isn't changed.
+    // Definitions of parent are copied on first use, without touching
+    // the parent's reference counts, so one parent can be shared by threads.
+    explicit Context(const Context* parent);
+
     const std::string& get_identifier(size_t index) const;
     size_t push_identifier(const std::string& identifier);
 
-    std::shared_ptr<Term> get_definition(const std::string& identifier) const;
-    void define(const std::string& identifier, std::shared_ptr<Term> t);
+    Ref<Term> get_definition(const std::string& identifier) const;
+    // optimize is false for definitions the optimizer already saw (restored ones)
+    void define(const std::string& identifier, Ref<Term> t, bool optimize = true);
+
+    // define stores what the optimizer returns (see optimizer.h)
+    // scratch contexts don't inherit it
+    using Optimizer = std::function<Ref<Term>(const std::string& identifier, Ref<Term> t)>;
+    void set_optimizer(Optimizer optimizer) { this->optimizer = std::move(optimizer); }
+    bool has_optimizer() const { return bool(optimizer); }
+
+    // own identifiers and definitions, without the parent's
+    const std::vector<std::string>& get_identifiers() const { return identifiers; }
+    const std::map<std::string, Ref<Term>>& get_definitions() const { return definitions; }
 
     void print(std::ostream& out) const;
 private:
+    const Term* find_definition(const std::string& identifier) const;
+
+    const Context* parent = nullptr;
+
     std::vector<std::string> identifiers;
 
-    std::map<std::string, std::shared_ptr<Term>> definitions;
+    std::map<std::string, Ref<Term>> definitions;
+    // copies of parent's definitions
+    mutable std::map<std::string, Ref<Term>> imported;
+
+    Optimizer optimizer;
 };
 
 
@@ -0,0 +1,128 @@
+#include "flat.h"
+#include <cstring>
+#include <stdexcept>
+
+void FlatTerm::assign(const Term& t) {
+    code.clear();
+
+    // right subterms that are still to be written
+    std::vector<const Term*> stack;
+    const Term* s = &t;
+    while (true) {
+        if (s->get_type() == Term::VARIABLE) {
+            size_t index = static_cast<const VariableTerm*>(s)->index;
+            assert(index <= UINT32_MAX - VARIABLE);
+            code.push_back(VARIABLE + index);
+            if (stack.empty())
+                break;
+            s = stack.back();
+            stack.pop_back();
+        } else if (s->get_type() == Term::ABSTRACTION) {
+            code.push_back(ABSTRACTION);
+            s = static_cast<const AbstractionTerm*>(s)->body.get();
+        } else { // if (Term::APPLICATION)
+            auto a = static_cast<const ApplicationTerm*>(s);
+            code.push_back(APPLICATION);
+            stack.push_back(a->right.get());
+            s = a->left.get();
+        }
+    }
+}
+
+
+Ref<Term> FlatTerm::to_term() const {
+    // Backwards, every subterm is complete when its first word is reached.
+    // The left subterm of an application ends up on top.
+    std::vector<Ref<Term>> stack;
+    for (size_t i = code.size(); i-- > 0;) {
+        uint32_t word = code[i];
+        if (word >= VARIABLE) {
+            stack.push_back(make_ref<VariableTerm>(word - VARIABLE));
+        } else if (word == ABSTRACTION) {
+            assert(stack.size() >= 1);
+            stack.back() = make_ref<AbstractionTerm>(std::move(stack.back()));
+        } else { // if (APPLICATION)
+            assert(stack.size() >= 2);
+            auto left = std::move(stack.back());
+            stack.pop_back();
+            stack.back() = make_ref<ApplicationTerm>(std::move(left), std::move(stack.back()));
+        }
+    }
+    assert(stack.size() == 1);
+    return stack.back();
+}
+
+
+size_t FlatTerm::hash() const {
+    // Independent lanes, so the loop can be vectorized.
+    const size_t lanes = 8;
+    uint32_t h[lanes];
+    for (size_t j = 0; j < lanes; ++j)
+        h[j] = 0x811c9dc5u + j;
+
+    const uint32_t* p = code.data();
+    size_t n = code.size() / lanes * lanes;
+    for (size_t i = 0; i < n; i += lanes) {
+        for (size_t j = 0; j < lanes; ++j)
+            h[j] = (h[j] ^ p[i+j]) * 0x01000193u;
+    }
+
+    uint64_t result = code.size();
+    for (size_t j = 0; j < lanes; ++j)
+        result = (result ^ h[j]) * 0x100000001b3ull;
+    for (size_t i = n; i < code.size(); ++i)
+        result = (result ^ p[i]) * 0x100000001b3ull;
+    return result ^ (result >> 32);
+}
+
+
+bool FlatTerm::operator==(const FlatTerm& o) const {
+    return code.size() == o.code.size() &&
+        std::memcmp(code.data(), o.code.data(), code.size() * sizeof(uint32_t)) == 0;
+}
+
+
+size_t FlatTerm::subterm_size(const uint32_t* begin, const uint32_t* end) {
+    // number of subterms still to be read
+    size_t pending = 1;
+    const uint32_t* p = begin;
+    while (pending > 0) {
+        if (p == end)
+            return 0;
+        if (*p >= VARIABLE)
+            pending--;
+        else if (*p == APPLICATION)
+            pending++;
+        p++;
+    }
+    return p - begin;
+}
+
+
+void FlatTerm::write(std::ostream& out) const {
+    uint64_t n = code.size();
+    out.write(reinterpret_cast<const char*>(&n), sizeof(n));
+    out.write(reinterpret_cast<const char*>(code.data()), n * sizeof(uint32_t));
+}
+
+
+FlatTerm FlatTerm::read(std::istream& in) {
+    uint64_t n;
+    if (!in.read(reinterpret_cast<char*>(&n), sizeof(n)))
+        throw std::runtime_error("Unexpected end of term data");
+
+    FlatTerm t;
+    // read in chunks, so a corrupted size doesn't allocate everything at once
+    const uint64_t chunk = 1 << 20;
+    for (uint64_t read = 0; read < n; read += chunk) {
+        size_t count = std::min(chunk, n - read);
+        t.code.resize(read + count);
+        if (!in.read(reinterpret_cast<char*>(t.code.data() + read), count * sizeof(uint32_t)))
+            throw std::runtime_error("Unexpected end of term data");
+    }
+
+    const uint32_t* end = t.code.data() + t.code.size();
+    if (n == 0 || subterm_size(t.code.data(), end) != n)
+        throw std::runtime_error("Malformed term data");
+    return t;
+}
@@ -0,0 +1,52 @@
+#ifndef FLAT_H
+#define FLAT_H
+
+#include <iostream>
+#include <vector>
+#include <cstdint>
+#include "term.h"
+
+// A term in prefix order, one word per node:
+//     APPLICATION, left..., right...
+//     ABSTRACTION, body...
+//     VARIABLE + index
+// Since it's one contiguous array, comparing and hashing are linear scans.
+class FlatTerm {
+public:
+    enum : uint32_t {
+        APPLICATION = 0,
+        ABSTRACTION = 1,
+        VARIABLE = 2
+    };
+
+    FlatTerm() = default;
+    explicit FlatTerm(const Term& t) { assign(t); }
+    // code must be one whole term, see subterm_size
+    explicit FlatTerm(std::vector<uint32_t> code) : code{std::move(code)} {
+        assert(subterm_size(this->code.data(), this->code.data() + this->code.size()) == this->code.size());
+    }
+
+    // reuses the buffer
+    void assign(const Term& t);
+    Ref<Term> to_term() const;
+
+    size_t size() const { return code.size(); }
+    const std::vector<uint32_t>& data() const { return code; }
+    size_t hash() const;
+
+    bool operator==(const FlatTerm& o) const;
+    bool operator!=(const FlatTerm& o) const { return !(*this == o); }
+
+    // native byte order
+    void write(std::ostream& out) const;
+    // throws std::runtime_error on malformed input
+    static FlatTerm read(std::istream& in);
+
+    // size of the subterm that starts at 'begin'
+    static size_t subterm_size(const uint32_t* begin, const uint32_t* end);
+
+private:
+    std::vector<uint32_t> code;
+};
+
+#endif
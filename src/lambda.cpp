@@ -0,0 +1,173 @@
+#include "lambda.h"
+#include "task.h"
+#include "checkpoint.h"
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <iterator>
+
+std::pair<Ref<Term>, bool> Lambda::step(Ref<Term> t, Strategy strategy) {
+    if (strategy == NORMAL)
+        return Term::reduce_leftmost(std::move(t));
+    return Term::beta_reduce(std::move(t));
+}
+
+
+Lambda::Result Lambda::eval(Ref<Term> t, const Options& options) {
+    EvalTask task = eval_task(std::move(t), options, 0);
+    task.resume();
+    return std::move(task.result());
+}
+
+
+namespace {
+    void run(std::istream& in, Context& context, Printer& printer, const Lambda::Options& options,
+            Lambda::Checkpointer* checkpointer, const Lambda::Checkpoint* resume, uint64_t program)
+    {
+        using namespace Lambda;
+
+        if (resume) {
+            resume->context->restore(context);
+            printer.set_next_binding(resume->next_binding);
+        }
+
+        std::string line;
+        size_t line_number = 1;
+        for (; std::getline(in, line); line_number++) {
+            if (in.eof())
+                break;
+
+            // the lines before the checkpoint are done
+            if (resume && line_number < resume->line_number)
+                continue;
+
+            Ref<Term> exp = nullptr;
+            size_t steps_done = 0;
+            bool checkpointed = false;
+            if (resume && line_number == resume->line_number && resume->term.size() > 0) {
+                exp = resume->term.to_term();
+                steps_done = resume->steps;
+                checkpointed = true;
+            } else {
+                std::istringstream sin(line);
+                try {
+                    exp = Parser::parse(sin, context);
+                } catch (const std::runtime_error& e) {
+                    printer.write("Error on line " + std::to_string(line_number) + ": ");
+                    printer.write(e.what());
+                    printer.newline();
+                    break;
+                }
+            }
+            if (!exp)
+                continue;
+
+            Options line_options = options;
+            if (options.observer) {
+                line_options.observer = [&](const FlatTerm& before, const FlatTerm& after, size_t steps) {
+                    options.observer(before, after, steps_done + steps);
+                };
+            }
+
+            // The context doesn't change while the line is evaluated,
+            // it's converted once for all its checkpoints.
+            std::shared_ptr<const Checkpoint::ContextData> context_data;
+            if (checkpointer) {
+                line_options.observer = [&, observer = line_options.observer]
+                    (const FlatTerm& before, const FlatTerm& after, size_t steps) {
+                    if (observer)
+                        observer(before, after, steps);
+                    if (!checkpointer->due())
+                        return;
+                    if (!context_data)
+                        context_data = std::make_shared<Checkpoint::ContextData>(context);
+                    printer.flush();
+                    checkpointer->save({program, options.strategy, options.max_steps,
+                        context.has_optimizer(), line_number, steps_done + steps,
+                        printer.get_next_binding(), context_data, after});
+                    checkpointed = true;
+                };
+            }
+
+            Result result;
+            if (options.max_steps != 0 && steps_done >= options.max_steps) {
+                result.term = std::move(exp);
+                result.finished = false;
+            } else {
+                if (options.max_steps != 0)
+                    line_options.max_steps -= steps_done;
+                result = eval(std::move(exp), line_options);
+            }
+
+            printer.print(*result.term, context);
+            printer.newline();
+            if (!result.finished) {
+                printer.write("Step limit reached on line " + std::to_string(line_number));
+                printer.newline();
+            }
+
+            // so a resumed run doesn't repeat this line
+            if (checkpointed) {
+                printer.flush();
+                checkpointer->save({program, options.strategy, options.max_steps,
+                    context.has_optimizer(), line_number + 1, 0, printer.get_next_binding(),
+                    std::make_shared<Checkpoint::ContextData>(context), {}});
+            }
+        }
+    }
+}
+
+
+void Lambda::run(std::istream& in, Context& context, Printer& printer, const Options& options) {
+    ::run(in, context, printer, options, nullptr, nullptr, 0);
+}
+
+
+void Lambda::run(std::istream& in, Context& context, Printer& printer, const Options& options,
+        Checkpointer& checkpointer, const Checkpoint* resume) {
+    // a checkpoint belongs to the program, it's read whole to be hashed
+    std::string program(std::istreambuf_iterator<char>(in), {});
+    uint64_t hash = Checkpoint::hash_program(program);
+    if (resume && (resume->program != hash || resume->strategy != options.strategy ||
+            resume->max_steps != options.max_steps || resume->optimized != context.has_optimizer()))
+        throw std::runtime_error("The checkpoint was saved by another program or with other options");
+
+    std::istringstream sin(program);
+    ::run(sin, context, printer, options, &checkpointer, resume, hash);
+}
+
+
+std::string Lambda::to_string(const Term& t, const Context& context, bool compact) {
+    std::ostringstream out;
+    {
+        Printer printer(out);
+        printer.set_compact(compact);
+        printer.print(t, context);
+    }
+    return out.str();
+}
+
+
+void Lambda::Interpreter::load(std::istream& in) {
+    std::string line;
+    size_t line_number = 1;
+    while(std::getline(in, line)) {
+        try {
+            // evaluation has no side effects, the expressions are only parsed
+            std::istringstream sin(line);
+            Parser::parse(sin, context);
+        } catch (const std::runtime_error& e) {
+            throw std::runtime_error("Error on line " + std::to_string(line_number) + ": " + e.what());
+        }
+        line_number++;
+    }
+}
+
+
+Lambda::Result Lambda::Interpreter::evaluate(const std::string& line) {
+    std::istringstream sin(line);
+    Ref<Term> exp = Parser::parse(sin, context);
+    if (!exp)
+        return {};
+    return eval(std::move(exp), options);
+}
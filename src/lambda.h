@@ -0,0 +1,101 @@
+#ifndef LAMBDA_H
+#define LAMBDA_H
+
+// Public interface of liblambda.
+//
+//     Lambda::Interpreter interpreter;
+//     interpreter.load(prelude_stream);
+//     auto result = interpreter.evaluate("add 2 3");
+//     std::cout << interpreter.to_string(*result.term);
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <functional>
+#include "term.h"
+#include "context.h"
+#include "parser.h"
+#include "printer.h"
+
+class FlatTerm;
+
+namespace Lambda {
+    struct Checkpoint;
+    class Checkpointer;
+
+    enum Strategy {
+        // contracts every outermost redex in one step
+        PARALLEL,
+        // contracts only the leftmost outermost redex in one step
+        NORMAL
+    };
+
+    struct Options {
+        Strategy strategy = PARALLEL;
+        // 0 means no limit
+        size_t max_steps = 0;
+        // called after every step, with the term before and after it
+        std::function<void(const FlatTerm& before, const FlatTerm& after, size_t steps)> observer;
+    };
+
+    struct Result {
+        // nullptr for lines without an expression (definitions, comments)
+        Ref<Term> term;
+        size_t steps = 0;
+        // false if max_steps was reached first or it was cancelled
+        bool finished = true;
+        bool cancelled = false;
+    };
+
+    // returns {new_expression, reduced}
+    std::pair<Ref<Term>, bool> step(Ref<Term> t, Strategy strategy);
+
+    // Reduces until a step doesn't change the term.
+    Result eval(Ref<Term> t, const Options& options = {});
+
+    // Parses and evaluates the lines of a program,
+    // printing every result, like the command line interpreter.
+    // Stops at the first syntax error.
+    void run(std::istream& in, Context& context, Printer& printer, const Options& options = {});
+    // Like run, but saves checkpoints while evaluating long lines,
+    // and continues from 'resume' if it's not null (context must be empty then).
+    // Throws std::runtime_error if 'resume' was saved by another program, options
+    // or with(out) an optimizer set on context.
+    // The printer is flushed before every checkpoint is saved, so no output is lost,
+    // but the output printed after the last checkpoint that reached the disk
+    // is printed again by the resumed run.
+    void run(std::istream& in, Context& context, Printer& printer, const Options& options,
+            Checkpointer& checkpointer, const Checkpoint* resume);
+
+    std::string to_string(const Term& t, const Context& context, bool compact = false);
+
+
+    // A context with its options.
+    class Interpreter {
+    public:
+        Interpreter(const Options& options = {}) : options{options} {}
+
+        // Reads the definitions of a program.
+        // Its expressions are parsed but not evaluated.
+        // Throws std::runtime_error on syntax errors.
+        void load(std::istream& in);
+
+        // Parses and evaluates one line.
+        // Throws std::runtime_error on syntax errors.
+        Result evaluate(const std::string& line);
+
+        std::string to_string(const Term& t, bool compact = false) const {
+            return Lambda::to_string(t, context, compact);
+        }
+
+        Context& get_context() { return context; }
+        const Context& get_context() const { return context; }
+        Options& get_options() { return options; }
+
+    private:
+        Context context;
+        Options options;
+    };
+}
+
+#endif
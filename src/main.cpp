@@ -1,28 +1,29 @@
-#include "term.h"
-#include "parser.h"
+#include "lambda.h"
+#include "server.h"
+#include "stepper.h"
+#include "checkpoint.h"
+#include "optimizer.h"
+#include "trace.h"
 #include <sstream>
 #include <fstream>
+#include <memory>
+#include <cstdio>
 #include <unistd.h>
 
 using namespace std;
 
-shared_ptr<Term> eval(shared_ptr<Term> t, const Context& context) {
-    shared_ptr<Term> prev = nullptr;
-    while(prev == nullptr || !prev->alpha_equivalent(t)) {
-        prev = t;
-        t = t->beta_reduce();
-        //t->print(cout, context, 0); cout<<endl;
-    }
-    return t;
-}
-
-
-void repl() {
+void repl(const Lambda::Options& options) {
     Context context;
 
     istringstream sin("none");
 
-    context.define("out", Parser::parse(sin, context));
+    // the last expression, stepped further by 'out', 'step' and 'normalize'
+    auto session = std::make_unique<Lambda::Stepper>(Parser::parse(sin, context));
+
+    auto print = [&]() {
+        session->get_term().print(cout, context, 0);
+        cout << endl;
+    };
 
     while (true) {
         cout << "> ";
@@ -43,6 +44,10 @@ void repl() {
             cout << "context" << endl;
             cout << "quit" << endl;
             cout << "help" << endl;
+            cout << "out" << endl;
+            cout << "step [N]" << endl;
+            cout << "normalize" << endl;
+            cout << "print" << endl;
             cout << "lambda_expression" << endl;
             cout << "define identifier lambda_expression" << endl;
             cout << endl;
@@ -62,13 +67,54 @@ void repl() {
                 << "\t> out\n"
                 << "\t$ #0 (#0 (($ #1 (#0 #0)) ($ #1 (#0 #0))))\n"
                 << "\t> out\n"
-                << "\t$ #0 (#0 (#0 (($ #1 (#0 #0)) ($ #1 (#0 #0)))))\n";
+                << "\t$ #0 (#0 (#0 (($ #1 (#0 #0)) ($ #1 (#0 #0)))))\n"
+                << endl
+                << "Every step reduces the leftmost outermost redex.\n"
+                << "'step N' and 'normalize' (until normal form or --max-steps)\n"
+                << "don't print the expression, 'print' does.\n";
             cout << endl;
             continue;
         }
 
+        if (command == "out") {
+            session->step();
+            print();
+            continue;
+        }
+
+        if (command == "print") {
+            print();
+            continue;
+        }
+
+        if (command == "normalize") {
+            size_t steps = 0;
+            while ((options.max_steps == 0 || steps < options.max_steps) && session->step())
+                steps++;
+            cout << steps << " steps" << (session->normal_form() ? ", normal form" : "") << endl;
+            continue;
+        }
+
+        if (command == "step" || command.rfind("step ", 0) == 0) {
+            size_t n = 1;
+            if (command != "step") {
+                try {
+                    n = std::stoul(command.substr(5));
+                } catch (const std::logic_error& e) {
+                    cout << "Error: step expects a number" << endl;
+                    continue;
+                }
+            }
+            size_t steps = session->step(n);
+            cout << steps << " steps" << (session->normal_form() ? ", normal form" : "") << endl;
+            continue;
+        }
 
-        std::shared_ptr<Term> exp = nullptr;
+        // the previous expression can be used as 'out'
+        context.define("out", session->share_term());
+
+
+        Ref<Term> exp = nullptr;
         try {
             sin = istringstream(command);
             exp = Parser::parse(sin, context);
@@ -77,54 +123,197 @@ void repl() {
         }
 
         if (exp) {
-            exp = exp->beta_reduce();
-            exp->print(cout, context, 0);
-            context.define("out", exp);
+            session = std::make_unique<Lambda::Stepper>(std::move(exp));
+            session->step();
+            print();
+        } else {
+            cout << endl;
         }
-        cout << endl;
     }
 }
 
 
-void run(std::istream& in) {
-    Context context;
-    std::string line;
-    size_t line_number = 1;
-    while(std::getline(in, line)) {
-        if (in.eof())
-            break;
+void usage(const char* name) {
+    cout << "Usage: " << name << " [options] [file]" << endl;
+    cout << "\t--compact        print repeated subterms as definitions" << endl;
+    cout << "\t--normal         reduce one leftmost outermost redex per step" << endl;
+    cout << "\t--max-steps N    stop reducing a line after N steps" << endl;
+    cout << "\t--serve          answer requests from stdin, with file as the prelude" << endl;
+    cout << "\t--threads N      number of threads for --serve" << endl;
+    cout << "\t--slice N        steps an evaluation runs before others get a turn" << endl;
+    cout << "\t--checkpoint F   save the state of long evaluations to F" << endl;
+    cout << "\t--checkpoint-interval S" << endl;
+    cout << "\t                 seconds between checkpoints (60)" << endl;
+    cout << "\t--resume         continue from the checkpoint, if there is one" << endl;
+    cout << "\t--optimize       reduce definitions when they are defined" << endl;
+    cout << "\t                 (not in the REPL), report to stderr" << endl;
+    cout << "\t--trace F        record the reductions of file to F" << endl;
+    cout << "\t--analyze F      summarize the trace F and exit" << endl;
+}
 
-        istringstream sin(line);
-        std::shared_ptr<Term> exp = nullptr;
-        try {
-            exp = Parser::parse(sin, context);
-        } catch (const std::runtime_error& e) {
-            cout << "Error on line " << line_number << ": ";
-            cout << e.what() << endl;
-            break;
+
+int main(int argc, char **argv) {
+    bool compact = false;
+    bool serve = false;
+    size_t threads = 0;
+    size_t slice = 100;
+    const char* checkpoint_path = nullptr;
+    double checkpoint_interval = 60;
+    bool resume = false;
+    bool optimize = false;
+    const char* trace_path = nullptr;
+    const char* analyze_path = nullptr;
+    Lambda::Options options;
+    const char* filename = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--compact") {
+            compact = true;
+        } else if (arg == "--normal") {
+            options.strategy = Lambda::NORMAL;
+        } else if (arg == "--serve") {
+            serve = true;
+        } else if (arg == "--resume") {
+            resume = true;
+        } else if (arg == "--optimize") {
+            optimize = true;
+        } else if (arg == "--checkpoint" && i + 1 < argc) {
+            checkpoint_path = argv[++i];
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace_path = argv[++i];
+        } else if (arg == "--analyze" && i + 1 < argc) {
+            analyze_path = argv[++i];
+        } else if (arg == "--checkpoint-interval" && i + 1 < argc) {
+            try {
+                checkpoint_interval = std::stod(argv[++i]);
+            } catch (const std::logic_error& e) {
+                usage(argv[0]);
+                return -1;
+            }
+        } else if ((arg == "--max-steps" || arg == "--threads" || arg == "--slice") && i + 1 < argc) {
+            size_t& value = arg == "--threads" ? threads :
+                arg == "--slice" ? slice : options.max_steps;
+            try {
+                value = std::stoul(argv[++i]);
+            } catch (const std::logic_error& e) {
+                usage(argv[0]);
+                return -1;
+            }
+        } else if (filename == nullptr && arg[0] != '-') {
+            filename = argv[i];
+        } else {
+            usage(argv[0]);
+            return -1;
         }
+    }
 
-        if (exp) {
-            exp = eval(exp, context);
-            exp->print(cout, context, 0);
-            cout << endl;
+    if (slice == 0) {
+        cout << "--slice must be at least 1" << endl;
+        return -1;
+    }
+
+    if (resume && checkpoint_path == nullptr) {
+        cout << "--resume needs --checkpoint" << endl;
+        return -1;
+    }
+
+    // evaluations in the server and the REPL aren't observed
+    if (trace_path && (serve || filename == nullptr)) {
+        cout << "--trace needs a file and doesn't work with --serve" << endl;
+        return -1;
+    }
+
+    if (analyze_path) {
+        std::ifstream fin(analyze_path, std::ios::binary);
+        if (!fin.good()) {
+            cout << "Couldn't open '" << analyze_path << "'" << endl;
+            return -1;
         }
-        line_number++;
+        try {
+            Lambda::analyze_trace(fin, cout);
+        } catch (const std::runtime_error& e) {
+            cout << "Couldn't analyze '" << analyze_path << "': " << e.what() << endl;
+            return -1;
+        }
+        return 0;
     }
-}
 
+    if (serve) {
+        Lambda::Interpreter prelude(options);
+        if (optimize)
+            prelude.get_context().set_optimizer(Lambda::Optimizer(&cerr));
+        if (filename) {
+            std::ifstream fin(filename);
+            if (!fin.good()) {
+                cout << "Couldn't open '" << filename << "'" << endl;
+                return -1;
+            }
+            try {
+                prelude.load(fin);
+            } catch (const std::runtime_error& e) {
+                cout << e.what() << endl;
+                return -1;
+            }
+        }
 
-int main(int argc, char **argv) {
-    if (argc == 2) {
-        std::ifstream fin(argv[1]);
+        Lambda::Server server(prelude.get_context(), options, threads);
+        server.set_compact(compact);
+        server.set_slice(slice);
+        server.serve(cin, cout);
+    } else if (filename) {
+        std::ifstream fin(filename);
 
         if (!fin.good()) {
-            cout << "Couldn't open '" << argv[1] << "'" << endl;
+            cout << "Couldn't open '" << filename << "'" << endl;
             return -1;
         }
-        run(fin);
+
+        Printer printer(cout);
+        printer.set_compact(compact);
+        printer.set_line_buffered(isatty(STDOUT_FILENO));
+        Context context;
+        if (optimize)
+            context.set_optimizer(Lambda::Optimizer(&cerr));
+
+        Lambda::Checkpoint checkpoint;
+        bool found = false;
+        if (checkpoint_path && resume) {
+            try {
+                found = Lambda::Checkpointer::load(checkpoint_path, checkpoint);
+            } catch (const std::runtime_error& e) {
+                cout << "Couldn't resume from '" << checkpoint_path << "': " << e.what() << endl;
+                return -1;
+            }
+        }
+
+        std::unique_ptr<Lambda::TraceRecorder> trace;
+        if (trace_path) {
+            try {
+                // a resumed run continues the trace of the run it resumes
+                trace = std::make_unique<Lambda::TraceRecorder>(trace_path, options.strategy, found);
+            } catch (const std::runtime_error& e) {
+                cout << e.what() << endl;
+                return -1;
+            }
+            options.observer = [&](const FlatTerm& before, const FlatTerm& after, size_t steps) {
+                trace->record(before, after, steps);
+            };
+        }
+        if (checkpoint_path) {
+            try {
+                Lambda::Checkpointer checkpointer(checkpoint_path, checkpoint_interval);
+                Lambda::run(fin, context, printer, options, checkpointer, found ? &checkpoint : nullptr);
+            } catch (const std::runtime_error& e) {
+                cout << "Couldn't resume from '" << checkpoint_path << "': " << e.what() << endl;
+                return -1;
+            }
+            // the run is over, there's nothing to resume
+            std::remove(checkpoint_path);
+        } else {
+            Lambda::run(fin, context, printer, options);
+        }
     } else {
-        repl();
+        repl(options);
     }
 
     return 0;
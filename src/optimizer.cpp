@@ -0,0 +1,127 @@
+#include "optimizer.h"
+#include "stepper.h"
+#include "flat.h"
+
+namespace {
+    // uses of the variable bound 'index' binders above t
+    size_t uses(const Term* t, size_t index) {
+        if (t->get_type() == Term::VARIABLE) {
+            return static_cast<const VariableTerm*>(t)->index == index;
+        } else if (t->get_type() == Term::ABSTRACTION) {
+            return uses(static_cast<const AbstractionTerm*>(t)->body.get(), index+1);
+        } else { // if (Term::APPLICATION)
+            auto a = static_cast<const ApplicationTerm*>(t);
+            return uses(a->left.get(), index) + uses(a->right.get(), index);
+        }
+    }
+
+    // contracts the redexes that don't make t bigger
+    Ref<Term> simplify(const Ref<Term>& t, size_t& steps) {
+        if (t->get_type() == Term::VARIABLE) {
+            return t;
+        } else if (t->get_type() == Term::ABSTRACTION) {
+            auto a = static_cast<AbstractionTerm*>(t.get());
+            auto body = simplify(a->body, steps);
+            if (body == a->body)
+                return t;
+            return make_ref<AbstractionTerm>(std::move(body));
+        } else { // if (Term::APPLICATION)
+            auto a = static_cast<ApplicationTerm*>(t.get());
+            auto left = simplify(a->left, steps);
+            auto right = simplify(a->right, steps);
+
+            if (left->get_type() == Term::ABSTRACTION) {
+                auto body = static_cast<AbstractionTerm*>(left.get())->body.get();
+                if (right->get_type() == Term::VARIABLE || uses(body, 0) <= 1) {
+                    steps++;
+                    auto redex = make_ref<ApplicationTerm>(std::move(left), std::move(right));
+                    // the result can have new redexes
+                    return simplify(Term::contract(std::move(redex)), steps);
+                }
+            }
+
+            if (left == a->left && right == a->right)
+                return t;
+            return make_ref<ApplicationTerm>(std::move(left), std::move(right));
+        }
+    }
+
+    Ref<Term> eta_reduce(const Ref<Term>& t, size_t& steps) {
+        if (t->get_type() == Term::VARIABLE) {
+            return t;
+        } else if (t->get_type() == Term::ABSTRACTION) {
+            auto a = static_cast<AbstractionTerm*>(t.get());
+            auto body = eta_reduce(a->body, steps);
+
+            // $ M #0
+            if (body->get_type() == Term::APPLICATION) {
+                auto application = static_cast<ApplicationTerm*>(body.get());
+                auto& m = application->left;
+                auto& last = application->right;
+                if (last->get_type() == Term::VARIABLE &&
+                        static_cast<VariableTerm*>(last.get())->index == 0 &&
+                        uses(m.get(), 0) == 0) {
+                    steps++;
+                    // #0 isn't used, so this only lowers the other indices
+                    return Term::subst(m, 0, m, 0);
+                }
+            }
+
+            if (body == a->body)
+                return t;
+            return make_ref<AbstractionTerm>(std::move(body));
+        } else { // if (Term::APPLICATION)
+            auto a = static_cast<ApplicationTerm*>(t.get());
+            auto left = eta_reduce(a->left, steps);
+            auto right = eta_reduce(a->right, steps);
+            if (left == a->left && right == a->right)
+                return t;
+            return make_ref<ApplicationTerm>(std::move(left), std::move(right));
+        }
+    }
+}
+
+
+Ref<Term> Lambda::Optimizer::optimize(Ref<Term> t, Stats& stats) const {
+    stats.size_before = FlatTerm(*t).size();
+    size_t max_size = stats.size_before * options.max_growth;
+
+    // t isn't changed, the stepper copies what it changes
+    Stepper stepper(t);
+    bool too_big = false;
+    while (stepper.get_steps() < options.max_steps && stepper.step()) {
+        if (FlatTerm(stepper.get_term()).size() > max_size) {
+            too_big = true;
+            break;
+        }
+    }
+
+    if (!too_big && stepper.normal_form()) {
+        stats.steps = stepper.get_steps();
+        t = stepper.share_term();
+    } else {
+        t = simplify(t, stats.steps);
+    }
+
+    if (options.eta)
+        t = eta_reduce(t, stats.eta_steps);
+
+    stats.size_after = FlatTerm(*t).size();
+    return t;
+}
+
+
+Ref<Term> Lambda::Optimizer::operator()(const std::string& identifier, Ref<Term> t) const {
+    Stats stats;
+    t = optimize(std::move(t), stats);
+
+    if (report && (stats.steps > 0 || stats.eta_steps > 0)) {
+        *report << "optimized '" << identifier << "': size "
+            << stats.size_before << " -> " << stats.size_after << ", "
+            << stats.steps << " steps";
+        if (stats.eta_steps > 0)
+            *report << ", " << stats.eta_steps << " eta";
+        *report << std::endl;
+    }
+    return t;
+}
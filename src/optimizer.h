@@ -0,0 +1,54 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <iostream>
+#include <string>
+#include "term.h"
+
+namespace Lambda {
+    // Reduces definitions when they are defined, so every use of a definition
+    // doesn't have to repeat the same redexes:
+    //     define and $$ cond #1 #0 F
+    // becomes
+    //     define and $$ #1 #0 ($$ #0)
+    //
+    // A definition is reduced to normal form if that takes at most max_steps
+    // and it doesn't grow beyond max_growth times its size. Otherwise only
+    // redexes that can't make it bigger are reduced: the ones whose variable
+    // is used at most once or whose argument is a variable.
+    //
+    // Eta reduction ($ M #0 becomes M, if M doesn't use #0) changes how
+    // results are printed, they are only equal up to eta.
+    class Optimizer {
+    public:
+        struct Options {
+            size_t max_steps = 1000;
+            double max_growth = 2;
+            bool eta = true;
+        };
+
+        struct Stats {
+            size_t size_before = 0;
+            size_t size_after = 0;
+            // the steps every use saves
+            size_t steps = 0;
+            size_t eta_steps = 0;
+        };
+
+        // report is written a line for every definition that changed
+        Optimizer(const Options& options, std::ostream* report = nullptr) :
+            options{options}, report{report} {}
+        Optimizer(std::ostream* report = nullptr) : report{report} {}
+
+        Ref<Term> optimize(Ref<Term> t, Stats& stats) const;
+
+        // for Context::set_optimizer
+        Ref<Term> operator()(const std::string& identifier, Ref<Term> t) const;
+
+    private:
+        Options options;
+        std::ostream* report;
+    };
+}
+
+#endif
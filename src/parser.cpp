@@ -101,7 +101,7 @@ void read_token(std::istream& in, Parser::Token& token) {
 
 
 
-std::shared_ptr<Term> Parser::parse(std::istream& in, Context& context) {
+Ref<Term> Parser::parse(std::istream& in, Context& context) {
     // SLR algorithm
     // http://www.cs.ecu.edu/karl/5220/spr16/Notes/Bottom-up/slr1.html
     // https://web.cs.dal.ca/~sjackson/lalr1.html
@@ -160,7 +160,7 @@ std::shared_ptr<Term> Parser::parse(std::istream& in, Context& context) {
 
     std::vector<int> stack = {0};
     std::vector<Parser::Token> token_stack;
-    std::vector<std::shared_ptr<Term>> term_stack;
+    std::vector<Ref<Term>> term_stack;
     size_t lambda_distance = 0;
 
     auto next_token = [&]() {
@@ -278,7 +278,7 @@ std::shared_ptr<Term> Parser::parse(std::istream& in, Context& context) {
                 term_stack.pop_back();
                 lambda_distance--;
 
-                term_stack.push_back(std::make_shared<AbstractionTerm>(body));
+                term_stack.push_back(make_ref<AbstractionTerm>(body));
             }
             // (3) A -> A I
             if (action_num == 3) {
@@ -288,7 +288,7 @@ std::shared_ptr<Term> Parser::parse(std::istream& in, Context& context) {
                 auto left = term_stack.back();
                 term_stack.pop_back();
                
-                term_stack.push_back(std::make_shared<ApplicationTerm>(left, right));
+                term_stack.push_back(make_ref<ApplicationTerm>(left, right));
             }
             // (5) I -> x
             if (action_num == 5) {
@@ -303,16 +303,16 @@ std::shared_ptr<Term> Parser::parse(std::istream& in, Context& context) {
                     if (token.identifier == "define")
                         throw std::runtime_error("'define' can't be a variable name");
 
-                    std::shared_ptr<Term> definition = context.get_definition(token.identifier);
+                    Ref<Term> definition = context.get_definition(token.identifier);
                     if (definition == nullptr) { // just a variable
                         token.index = context.push_identifier(token.identifier);
                         token.index += lambda_distance;
-                        term_stack.push_back(std::make_shared<VariableTerm>(token.index));
+                        term_stack.push_back(make_ref<VariableTerm>(token.index));
                     } else { // a definition
-                        term_stack.push_back(definition->lift(0, lambda_distance));
+                        term_stack.push_back(Term::lift(definition, 0, lambda_distance));
                     }
                 } else {
-                    term_stack.push_back(std::make_shared<VariableTerm>(token.index));
+                    term_stack.push_back(make_ref<VariableTerm>(token.index));
                 }
             }
 
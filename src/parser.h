@@ -24,7 +24,7 @@ namespace Parser {
         std::string str;
     };
 
-    std::shared_ptr<Term> parse(std::istream& in, Context& context);
+    Ref<Term> parse(std::istream& in, Context& context);
 }
 
 #endif
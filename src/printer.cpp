@@ -0,0 +1,341 @@
+#include "printer.h"
+#include <charconv>
+#include <cstdint>
+
+// smallest subterm worth a binding (in nodes)
+static const size_t min_binding_size = 4;
+
+
+Printer::Printer(std::ostream& out, size_t buffer_size) :
+    out{out}, buffer_size{buffer_size}
+{
+    buffer.reserve(buffer_size);
+}
+
+Printer::~Printer() {
+    flush();
+}
+
+
+void Printer::write(const std::string& s) {
+    buffer += s;
+    if (buffer.size() >= buffer_size)
+        flush();
+}
+
+void Printer::put(char c) {
+    buffer.push_back(c);
+}
+
+void Printer::newline() {
+    buffer.push_back('\n');
+    if (line_buffered || buffer.size() >= buffer_size)
+        flush();
+}
+
+void Printer::flush() {
+    out.write(buffer.data(), buffer.size());
+    out.flush();
+    buffer.clear();
+}
+
+void Printer::write_number(size_t n) {
+    char digits[24];
+    auto end = std::to_chars(digits, digits + sizeof(digits), n).ptr;
+    buffer.append(digits, end);
+}
+
+
+void Printer::print(const Term& t, const Context& context, size_t distance) {
+    if (compact)
+        print_bindings(t, context, distance);
+
+    print_term(t, context, distance);
+
+    term_class.clear();
+    class_binding.clear();
+
+    if (buffer.size() >= buffer_size)
+        flush();
+}
+
+
+size_t Printer::binding_of(const Term* t, size_t distance) const {
+    if (class_binding.empty())
+        return none;
+    return class_binding[term_class.at({t, distance})];
+}
+
+
+size_t Printer::ClassTable::slot_of(const Occurrence& o) const {
+    // capacity is a power of two, the high bits of the product are the best mixed
+    uint64_t h = (reinterpret_cast<uintptr_t>(o.term) ^ (o.distance << 48)) * 0x9e3779b97f4a7c15ull;
+    size_t mask = slots.size() - 1;
+    size_t i = (h ^ (h >> 32)) & mask;
+    while (slots[i].term != nullptr && (slots[i].term != o.term || slots[i].distance != o.distance))
+        i = (i + 1) & mask;
+    return i;
+}
+
+
+size_t Printer::ClassTable::find(const Occurrence& o) const {
+    if (slots.empty())
+        return none;
+    const Slot& slot = slots[slot_of(o)];
+    return slot.term != nullptr ? slot.c : none;
+}
+
+
+void Printer::ClassTable::insert(const Occurrence& o, size_t c) {
+    // at most half full, so probes stay short
+    if (2 * (count + 1) > slots.size())
+        grow();
+    Slot& slot = slots[slot_of(o)];
+    if (slot.term == nullptr)
+        count++;
+    slot = {o.term, o.distance, c};
+}
+
+
+void Printer::ClassTable::grow() {
+    std::vector<Slot> old(std::max<size_t>(16, 2 * slots.size()));
+    std::swap(old, slots);
+    for (auto& slot : old) {
+        if (slot.term != nullptr)
+            slots[slot_of({slot.term, slot.distance})] = slot;
+    }
+}
+
+
+void Printer::print_term(const Term& t, const Context& context, size_t distance) {
+    // an item is either a term to print or a single character
+    struct Item {
+        const Term* term;
+        size_t distance;
+        char c;
+    };
+    std::vector<Item> stack = {{&t, distance, 0}};
+
+    // bound subterms print as a name, which behaves like a variable
+    auto atomic = [&](const Term* s, size_t distance) {
+        return s->get_type() == Term::VARIABLE || binding_of(s, distance) != none;
+    };
+
+    while (!stack.empty()) {
+        // a large term is written as it's printed, not held in the buffer
+        if (buffer.size() >= buffer_size)
+            flush();
+
+        Item item = stack.back();
+        stack.pop_back();
+
+        if (item.term == nullptr) {
+            buffer.push_back(item.c);
+            continue;
+        }
+
+        if (item.term != &t) {
+            size_t binding = binding_of(item.term, item.distance);
+            if (binding != none) {
+                buffer.push_back('%');
+                write_number(binding);
+                continue;
+            }
+        }
+
+        switch (item.term->get_type()) {
+            case Term::VARIABLE: {
+                auto v = static_cast<const VariableTerm*>(item.term);
+                if (v->index >= item.distance) {
+                    buffer += context.get_identifier(v->index - item.distance);
+                } else {
+                    buffer.push_back('#');
+                    write_number(v->index);
+                }
+                break;}
+            case Term::ABSTRACTION: {
+                auto a = static_cast<const AbstractionTerm*>(item.term);
+                const Term* body = a->body.get();
+                buffer.push_back('$');
+                if (body->get_type() != Term::ABSTRACTION || atomic(body, item.distance+1))
+                    buffer.push_back(' ');
+
+#ifdef TERM_PRINT_ALL_PAREN
+                stack.push_back({nullptr, 0, ')'});
+                stack.push_back({body, item.distance+1, 0});
+                stack.push_back({nullptr, 0, '('});
+#else
+                stack.push_back({body, item.distance+1, 0});
+#endif
+                break;}
+            case Term::APPLICATION: {
+                auto a = static_cast<const ApplicationTerm*>(item.term);
+                const Term* left = a->left.get();
+                const Term* right = a->right.get();
+                bool left_paren = left->get_type() == Term::ABSTRACTION && !atomic(left, item.distance);
+                bool right_paren = !atomic(right, item.distance);
+
+#ifdef TERM_PRINT_ALL_PAREN
+                left_paren = right_paren = true;
+#endif
+
+                // pushed in reverse
+                if (right_paren) stack.push_back({nullptr, 0, ')'});
+                stack.push_back({right, item.distance, 0});
+                if (right_paren) stack.push_back({nullptr, 0, '('});
+                stack.push_back({nullptr, 0, ' '});
+                if (left_paren) stack.push_back({nullptr, 0, ')'});
+                stack.push_back({left, item.distance, 0});
+                if (left_paren) stack.push_back({nullptr, 0, '('});
+                break;}
+        }
+    }
+}
+
+
+void Printer::print_bindings(const Term& t, const Context& context, size_t distance) {
+    // Classes are assigned bottom-up by hash-consing the node shape.
+    // De Bruijn indices make structural equality an alpha-equivalence.
+    // Variables of the context get their own shape, by identifier,
+    // so subterms that mention them can be bound too.
+    const size_t identifier = Term::APPLICATION + 1;
+    struct Shape {
+        size_t type, a, b;
+        bool operator==(const Shape& o) const {
+            return type == o.type && a == o.a && b == o.b;
+        }
+    };
+    struct ShapeHash {
+        size_t operator()(const Shape& s) const {
+            size_t h = s.type;
+            h = h * 0x9e3779b97f4a7c15ull + s.a;
+            h = h * 0x9e3779b97f4a7c15ull + s.b;
+            return h ^ (h >> 29);
+        }
+    };
+    std::unordered_map<Shape, size_t, ShapeHash> classes;
+    std::vector<size_t> class_size;
+    // number of enclosing binders the class needs to be closed
+    std::vector<size_t> class_free;
+
+    auto push_children = [](auto& stack, const Term* s, size_t distance) {
+        if (s->get_type() == Term::ABSTRACTION) {
+            stack.push_back({{static_cast<const AbstractionTerm*>(s)->body.get(), distance+1}, false});
+        } else if (s->get_type() == Term::APPLICATION) {
+            auto a = static_cast<const ApplicationTerm*>(s);
+            stack.push_back({{a->right.get(), distance}, false});
+            stack.push_back({{a->left.get(), distance}, false});
+        }
+    };
+
+    // post-order, shared nodes are classified once
+    // the classes of finished subterms are on 'results', the last one on top
+    std::vector<std::pair<Occurrence, bool>> stack = {{{&t, distance}, false}};
+    std::vector<size_t> results;
+    while (!stack.empty()) {
+        auto [o, expanded] = stack.back();
+        stack.pop_back();
+        const Term* s = o.term;
+
+        if (!expanded) {
+            size_t found = term_class.find(o);
+            if (found != none) {
+                results.push_back(found);
+                continue;
+            }
+            stack.push_back({o, true});
+            push_children(stack, s, o.distance);
+            continue;
+        }
+
+        Shape shape;
+        size_t size, free;
+        if (s->get_type() == Term::VARIABLE) {
+            size_t index = static_cast<const VariableTerm*>(s)->index;
+            if (index >= o.distance) {
+                shape = {identifier, index - o.distance, 0};
+                free = 0;
+            } else {
+                shape = {Term::VARIABLE, index, 0};
+                free = index + 1;
+            }
+            size = 1;
+        } else if (s->get_type() == Term::ABSTRACTION) {
+            size_t body = results.back();
+            results.pop_back();
+            shape = {Term::ABSTRACTION, body, 0};
+            size = class_size[body] + 1;
+            free = class_free[body] > 0 ? class_free[body] - 1 : 0;
+        } else { // if (Term::APPLICATION)
+            size_t right = results.back();
+            results.pop_back();
+            size_t left = results.back();
+            results.pop_back();
+            shape = {Term::APPLICATION, left, right};
+            size = class_size[left] + class_size[right] + 1;
+            free = std::max(class_free[left], class_free[right]);
+        }
+
+        auto [iter, inserted] = classes.insert({shape, class_size.size()});
+        if (inserted) {
+            class_size.push_back(size);
+            class_free.push_back(free);
+        }
+        term_class.insert(o, iter->second);
+        results.push_back(iter->second);
+    }
+
+    auto candidate = [&](size_t c) {
+        return class_free[c] == 0 && class_size[c] >= min_binding_size;
+    };
+
+    // Count references the way they will be printed:
+    // a candidate's subterms are only seen at its first occurrence.
+    std::vector<size_t> refs(class_size.size(), 0);
+    stack = {{{&t, distance}, false}};
+    while (!stack.empty()) {
+        Occurrence o = stack.back().first;
+        stack.pop_back();
+
+        size_t c = term_class.at(o);
+        if (candidate(c) && refs[c]++ > 0)
+            continue;
+        push_children(stack, o.term, o.distance);
+    }
+
+    // Print definitions in post-order, so a binding is defined before it's used.
+    // Names are assigned as they are printed.
+    std::vector<bool> bound(class_size.size(), false);
+    for (size_t c = 0; c < class_size.size(); ++c)
+        bound[c] = candidate(c) && refs[c] > 1;
+    class_binding.assign(class_size.size(), none);
+
+    std::vector<bool> visited(class_size.size(), false);
+    stack = {{{&t, distance}, false}};
+    while (!stack.empty()) {
+        auto [o, expanded] = stack.back();
+        stack.pop_back();
+        size_t c = term_class.at(o);
+
+        if (!expanded) {
+            if (bound[c]) {
+                if (visited[c])
+                    continue;
+                visited[c] = true;
+            }
+            stack.push_back({o, true});
+            push_children(stack, o.term, o.distance);
+            continue;
+        }
+
+        if (bound[c] && o.term != &t) {
+            buffer += "define %";
+            write_number(next_binding);
+            buffer.push_back(' ');
+            // at its own distance, so context variables print as their names
+            print_term(*o.term, context, o.distance);
+            newline();
+            class_binding[c] = next_binding++;
+        }
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef PRINTER_H
+#define PRINTER_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "term.h"
+#include "context.h"
+
+// Buffered output for terms.
+// Terms are printed without recursion into one large buffer
+// that is written to the stream when it fills up (or on flush()).
+//
+// In compact mode closed subterms that occur more than once are printed once,
+// as 'define' lines before the term, and referred to by name:
+//     define %0 $$ #1
+//     $$ #0 %0 (%0 #1 #0)
+// Free variables of the context count as closed, they print as their names.
+// The output stays a valid program.
+class Printer {
+public:
+    Printer(std::ostream& out, size_t buffer_size = 1 << 20);
+    ~Printer();
+
+    void set_compact(bool compact) { this->compact = compact; }
+    // flush after every line (for terminals)
+    void set_line_buffered(bool line_buffered) { this->line_buffered = line_buffered; }
+    // the number of the next compact mode binding, to continue an output
+    size_t get_next_binding() const { return next_binding; }
+    void set_next_binding(size_t next_binding) { this->next_binding = next_binding; }
+
+    void print(const Term& t, const Context& context, size_t distance = 0);
+
+    void write(const std::string& s);
+    void put(char c);
+    void newline();
+    void flush();
+
+    Printer(const Printer& o) = delete;
+    void operator=(const Printer& o) = delete;
+private:
+    // no binding
+    static constexpr size_t none = -1;
+
+    // finds repeated closed subterms and prints their 'define' lines
+    void print_bindings(const Term& t, const Context& context, size_t distance);
+    // prints t, using binding names for subterms other than t itself
+    void print_term(const Term& t, const Context& context, size_t distance);
+    size_t binding_of(const Term* t, size_t distance) const;
+    void write_number(size_t n);
+
+    std::ostream& out;
+    std::string buffer;
+    size_t buffer_size;
+    bool compact = false;
+    bool line_buffered = false;
+
+    // binding names are unique for the whole output
+    size_t next_binding = 0;
+
+    // A subterm at a distance from the root, the same node can mean
+    // different context variables at different distances.
+    struct Occurrence {
+        const Term* term;
+        size_t distance;
+    };
+
+    // Occurrence -> class, by open addressing.
+    // It gets an entry for every node of the term, a node based map
+    // would spend most of the time allocating.
+    class ClassTable {
+    public:
+        // none if it's not there
+        size_t find(const Occurrence& o) const;
+        size_t at(const Occurrence& o) const {
+            size_t c = find(o);
+            assert(c != none);
+            return c;
+        }
+        void insert(const Occurrence& o, size_t c);
+        // releases the memory, it can be large after a large term
+        void clear() { slots = {}; count = 0; }
+    private:
+        struct Slot {
+            const Term* term = nullptr;
+            size_t distance = 0;
+            size_t c = 0;
+        };
+        size_t slot_of(const Occurrence& o) const;
+        void grow();
+
+        std::vector<Slot> slots;
+        size_t count = 0;
+    };
+
+    // compact mode state, valid during one print
+    // structurally equal subterms have the same class
+    ClassTable term_class;
+    std::vector<size_t> class_binding;      // binding name or none
+};
+
+#endif
@@ -0,0 +1,96 @@
+#ifndef REF_H
+#define REF_H
+
+#include <cstddef>
+#include <utility>
+
+// Intrusive, non-atomic reference counting pointer.
+// T needs a 'mutable size_t refcount' member and a virtual destructor
+// if it's deleted through a base class.
+//
+// Unlike std::shared_ptr the count is cheap to read,
+// so code can check unique() and reuse a node instead of copying it.
+template <class T>
+class Ref {
+public:
+    Ref() : ptr{nullptr} {}
+    Ref(std::nullptr_t) : ptr{nullptr} {}
+    explicit Ref(T* ptr) : ptr{ptr} { retain(); }
+
+    Ref(const Ref& o) : ptr{o.ptr} { retain(); }
+    Ref(Ref&& o) : ptr{o.ptr} { o.ptr = nullptr; }
+
+    template <class U>
+    Ref(const Ref<U>& o) : ptr{o.get()} { retain(); }
+    template <class U>
+    Ref(Ref<U>&& o) : ptr{o.release()} {}
+
+    ~Ref() { reset(); }
+
+    Ref& operator=(Ref o) {
+        std::swap(ptr, o.ptr);
+        return *this;
+    }
+
+    T* get() const { return ptr; }
+    T* operator->() const { return ptr; }
+    T& operator*() const { return *ptr; }
+    explicit operator bool() const { return ptr != nullptr; }
+
+    size_t use_count() const { return ptr ? ptr->refcount : 0; }
+    // the caller holds the only reference, so the object can be changed in-place
+    bool unique() const { return use_count() == 1; }
+
+    void reset() {
+        if (ptr && --ptr->refcount == 0)
+            delete ptr;
+        ptr = nullptr;
+    }
+
+    // gives up ownership without decrementing the count
+    T* release() {
+        T* p = ptr;
+        ptr = nullptr;
+        return p;
+    }
+
+    // takes ownership of a pointer that was release()d
+    static Ref adopt(T* ptr) {
+        Ref r;
+        r.ptr = ptr;
+        return r;
+    }
+
+private:
+    void retain() {
+        if (ptr) ++ptr->refcount;
+    }
+
+    T* ptr;
+};
+
+template <class T, class U>
+bool operator==(const Ref<T>& a, const Ref<U>& b) { return a.get() == b.get(); }
+template <class T, class U>
+bool operator!=(const Ref<T>& a, const Ref<U>& b) { return a.get() != b.get(); }
+template <class T>
+bool operator==(const Ref<T>& a, std::nullptr_t) { return a.get() == nullptr; }
+template <class T>
+bool operator!=(const Ref<T>& a, std::nullptr_t) { return a.get() != nullptr; }
+
+template <class T, class... Args>
+Ref<T> make_ref(Args&&... args) {
+    return Ref<T>(new T(std::forward<Args>(args)...));
+}
+
+template <class T, class U>
+Ref<T> static_ref_cast(const Ref<U>& r) {
+    return Ref<T>(static_cast<T*>(r.get()));
+}
+
+template <class T, class U>
+Ref<T> static_ref_cast(Ref<U>&& r) {
+    return Ref<T>::adopt(static_cast<T*>(r.release()));
+}
+
+#endif
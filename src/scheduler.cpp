@@ -0,0 +1,85 @@
+#include "scheduler.h"
+
+Lambda::Scheduler::Scheduler(size_t threads) {
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < threads; ++i)
+        workers.emplace_back(&Scheduler::work, this);
+}
+
+
+Lambda::Scheduler::~Scheduler() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    ready_changed.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+
+size_t Lambda::Scheduler::submit(EvalTask task, Callback done) {
+    std::lock_guard<std::mutex> lock(mutex);
+    size_t id = next_id++;
+    auto job = std::make_unique<Job>(Job{id, std::move(task), std::move(done)});
+    jobs[id] = job.get();
+    ready.push_back(std::move(job));
+    ready_changed.notify_one();
+    return id;
+}
+
+
+void Lambda::Scheduler::cancel(size_t id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto iter = jobs.find(id);
+    if (iter != jobs.end())
+        iter->second->task.cancel();
+}
+
+
+void Lambda::Scheduler::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    jobs_changed.wait(lock, [&]() { return jobs.empty(); });
+}
+
+
+void Lambda::Scheduler::work() {
+    while (true) {
+        std::unique_ptr<Job> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            ready_changed.wait(lock, [&]() { return stopping || !ready.empty(); });
+            if (ready.empty())
+                return;
+            job = std::move(ready.front());
+            ready.pop_front();
+        }
+
+        if (job->task.resume()) {
+            // back of the line
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.push_back(std::move(job));
+            ready_changed.notify_one();
+            continue;
+        }
+
+        Result* result = nullptr;
+        std::exception_ptr error;
+        try {
+            result = &job->task.result();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        try {
+            job->done(result, error);
+        } catch (...) {
+            // the job is over anyway, wait() mustn't hang on it
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.erase(job->id);
+        jobs_changed.notify_all();
+    }
+}
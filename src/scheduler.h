@@ -0,0 +1,62 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <functional>
+#include <exception>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <vector>
+#include "task.h"
+
+namespace Lambda {
+    // Runs many evaluations on a fixed number of threads.
+    // Tasks take turns, one slice each, so short evaluations
+    // finish quickly even next to long ones.
+    class Scheduler {
+    public:
+        // called on a worker thread when the task is over, with its result,
+        // or with nullptr and the exception the evaluation threw
+        // must not throw
+        using Callback = std::function<void(Result* result, std::exception_ptr error)>;
+
+        // 0 threads means one per core
+        Scheduler(size_t threads = 0);
+        // waits for the submitted tasks
+        ~Scheduler();
+
+        // returns an id for cancel()
+        size_t submit(EvalTask task, Callback done);
+        // does nothing if the task is already over
+        void cancel(size_t id);
+        // until every submitted task is over
+        void wait();
+
+        Scheduler(const Scheduler& o) = delete;
+        void operator=(const Scheduler& o) = delete;
+    private:
+        struct Job {
+            size_t id;
+            EvalTask task;
+            Callback done;
+        };
+
+        void work();
+
+        std::mutex mutex;
+        std::condition_variable ready_changed;
+        std::condition_variable jobs_changed;
+        std::deque<std::unique_ptr<Job>> ready;
+        // every job that isn't over, for cancel()
+        std::map<size_t, Job*> jobs;
+        size_t next_id = 0;
+        bool stopping = false;
+
+        std::vector<std::thread> workers;
+    };
+}
+
+#endif
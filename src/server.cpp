@@ -0,0 +1,119 @@
+#include "server.h"
+#include "scheduler.h"
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <mutex>
+#include <map>
+#include <memory>
+
+Lambda::Server::Server(const Context& prelude, const Options& options, size_t threads) :
+    prelude{prelude}, options{options}, threads{threads}
+{
+}
+
+
+Ref<Term> Lambda::Server::parse(const std::string& request, Context& context) const {
+    // Evaluation has no side effects,
+    // so only the last expression has to be evaluated.
+    Ref<Term> last;
+    std::istringstream statements(request);
+    std::string statement;
+    while (std::getline(statements, statement, '\t')) {
+        std::istringstream sin(statement);
+        Ref<Term> exp = Parser::parse(sin, context);
+        if (exp)
+            last = std::move(exp);
+    }
+    return last;
+}
+
+
+std::string Lambda::Server::format(const Result& result, const Context& context) const {
+    if (result.cancelled)
+        return "cancelled";
+    // compact mode prints the bindings on lines of their own
+    std::string term = to_string(*result.term, context, compact);
+    std::replace(term.begin(), term.end(), '\n', '\t');
+    return std::string(result.finished ? "ok " : "limit ") + term;
+}
+
+
+void Lambda::Server::serve(std::istream& in, std::ostream& out) {
+    std::mutex out_mutex;
+    auto respond = [&](const std::string& tag, const std::string& response) {
+        std::string line = tag + " " + response + "\n";
+        std::lock_guard<std::mutex> lock(out_mutex);
+        out.write(line.data(), line.size());
+        out.flush();
+    };
+
+    // tags of running requests, for cancel
+    // tag -> {request number, scheduler id}
+    std::mutex running_mutex;
+    std::map<std::string, std::pair<size_t, size_t>> running;
+    size_t request_number = 0;
+
+    Scheduler scheduler(threads);
+
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty())
+            continue;
+
+        size_t split = line.find(' ');
+        std::string tag = line.substr(0, split);
+        std::string request = split == std::string::npos ? "" : line.substr(split + 1);
+
+        if (tag == "cancel") {
+            std::lock_guard<std::mutex> lock(running_mutex);
+            auto iter = running.find(request);
+            if (iter != running.end())
+                scheduler.cancel(iter->second.second);
+            continue;
+        }
+
+        // Parsed here, evaluated and printed on a worker.
+        // Only the callback keeps the context, so its terms are
+        // never touched by two threads at once.
+        auto context = std::make_shared<Context>(&prelude);
+        Ref<Term> exp;
+        try {
+            exp = parse(request, *context);
+        } catch (const std::runtime_error& e) {
+            respond(tag, std::string("error ") + e.what());
+            continue;
+        }
+        if (!exp) {
+            respond(tag, "ok");
+            continue;
+        }
+
+        std::lock_guard<std::mutex> lock(running_mutex);
+        size_t number = request_number++;
+        size_t id = scheduler.submit(eval_task(std::move(exp), options, slice),
+            [this, tag, number, context = std::move(context), &respond, &running, &running_mutex]
+            (Result* result, std::exception_ptr error) {
+                std::string response;
+                try {
+                    if (error)
+                        std::rethrow_exception(error);
+                    response = format(*result, *context);
+                } catch (const std::exception& e) {
+                    response = std::string("error ") + e.what();
+                } catch (...) {
+                    response = "error unknown exception";
+                }
+                respond(tag, response);
+
+                // unless the tag was reused by a later request
+                std::lock_guard<std::mutex> lock(running_mutex);
+                auto iter = running.find(tag);
+                if (iter != running.end() && iter->second.first == number)
+                    running.erase(iter);
+            });
+        running[tag] = {number, id};
+    }
+
+    scheduler.wait();
+}
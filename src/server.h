@@ -0,0 +1,54 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <iostream>
+#include <algorithm>
+#include <string>
+#include "lambda.h"
+
+namespace Lambda {
+    // Serves evaluation requests, one per line, from a pool of threads.
+    //
+    // Request:  tag statement TAB statement TAB ...
+    //           cancel tag
+    // Response: tag ok [term]
+    //           tag limit term
+    //           tag cancelled
+    //           tag error message
+    //
+    // Statements are lines of a program, separated by tabs: every printable
+    // character can be part of an identifier, and ';' starts comments.
+    // In compact mode the term's 'define' lines come first, separated by
+    // tabs too, so a response is still one line.
+    // Every request gets its own scratch context on top of the prelude,
+    // so its definitions don't leak.
+    // The term is the result of the last expression, responses come in
+    // the order they are finished and carry the tag of their request.
+    // Evaluations share the threads in slices (see Scheduler).
+    class Server {
+    public:
+        // prelude is shared by all threads and must not change while serving
+        Server(const Context& prelude, const Options& options = {}, size_t threads = 0);
+
+        void set_compact(bool compact) { this->compact = compact; }
+        // steps an evaluation runs before others get a turn
+        // at least 1, an evaluation that never suspends can't be cancelled
+        void set_slice(size_t slice) { this->slice = std::max<size_t>(slice, 1); }
+
+        // returns when 'in' ends and all requests are answered
+        void serve(std::istream& in, std::ostream& out);
+
+    private:
+        // returns the last expression, definitions go to context
+        Ref<Term> parse(const std::string& request, Context& context) const;
+        std::string format(const Result& result, const Context& context) const;
+
+        const Context& prelude;
+        Options options;
+        size_t threads;
+        bool compact = false;
+        size_t slice = 100;
+    };
+}
+
+#endif
@@ -0,0 +1,123 @@
+#include "stepper.h"
+
+Lambda::Stepper::Stepper(Ref<Term> term) : root{std::move(term)} {
+    assert(root != nullptr);
+    make_unique(root);
+    slots = {&root};
+    find_redex();
+}
+
+
+void Lambda::Stepper::make_unique(Ref<Term>& slot) {
+    if (slot.unique())
+        return;
+
+    // a shallow copy, the children become shared
+    if (slot->get_type() == Term::VARIABLE) {
+        slot = make_ref<VariableTerm>(static_cast<VariableTerm*>(slot.get())->index);
+    } else if (slot->get_type() == Term::ABSTRACTION) {
+        slot = make_ref<AbstractionTerm>(static_cast<AbstractionTerm*>(slot.get())->body);
+    } else { // if (Term::APPLICATION)
+        auto t = static_cast<ApplicationTerm*>(slot.get());
+        slot = make_ref<ApplicationTerm>(t->left, t->right);
+    }
+}
+
+
+void Lambda::Stepper::descend(Direction direction) {
+    Term* t = slots.back()->get();
+    Ref<Term>* child;
+    if (direction == BODY)
+        child = &static_cast<AbstractionTerm*>(t)->body;
+    else if (direction == LEFT)
+        child = &static_cast<ApplicationTerm*>(t)->left;
+    else
+        child = &static_cast<ApplicationTerm*>(t)->right;
+
+    make_unique(*child);
+    slots.push_back(child);
+    directions.push_back(direction);
+}
+
+
+bool Lambda::Stepper::ascend_right() {
+    while (!directions.empty()) {
+        Direction direction = directions.back();
+        slots.pop_back();
+        directions.pop_back();
+        if (direction == LEFT) {
+            descend(RIGHT);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void Lambda::Stepper::find_redex() {
+    while (true) {
+        const Term* t = slots.back()->get();
+        if (t->get_type() == Term::APPLICATION) {
+            if (static_cast<const ApplicationTerm*>(t)->left->get_type() == Term::ABSTRACTION) {
+                found = true;
+                return;
+            }
+            descend(LEFT);
+        } else if (t->get_type() == Term::ABSTRACTION) {
+            descend(BODY);
+        } else if (!ascend_right()) {
+            found = false;
+            return;
+        }
+    }
+}
+
+
+void Lambda::Stepper::rebuild() {
+    make_unique(root);
+    slots = {&root};
+    std::vector<Direction> path;
+    std::swap(path, directions);
+    for (Direction direction : path)
+        descend(direction);
+    shared = false;
+}
+
+
+Ref<Term> Lambda::Stepper::share_term() {
+    shared = true;
+    return root;
+}
+
+
+bool Lambda::Stepper::step() {
+    if (!found)
+        return false;
+    if (shared)
+        rebuild();
+
+    Ref<Term>& slot = *slots.back();
+    slot = Term::contract(std::move(slot));
+    make_unique(slot);
+    steps++;
+
+    // Everything before the focus was searched already and didn't change.
+    // Only the parent can have become a redex, if the focus is its left side.
+    if (!directions.empty() && directions.back() == LEFT &&
+            slot->get_type() == Term::ABSTRACTION) {
+        slots.pop_back();
+        directions.pop_back();
+        return true;
+    }
+
+    find_redex();
+    return true;
+}
+
+
+size_t Lambda::Stepper::step(size_t n) {
+    size_t done = 0;
+    while (done < n && step())
+        done++;
+    return done;
+}
@@ -0,0 +1,62 @@
+#ifndef STEPPER_H
+#define STEPPER_H
+
+#include <vector>
+#include "term.h"
+
+namespace Lambda {
+    // Steps a term in normal order (leftmost outermost redex first).
+    //
+    // Keeps the path from the root to the next redex (a zipper), so a step
+    // only costs the substitution and the search onwards from there,
+    // not a walk over the whole term.
+    // Nodes on the path are kept unique, so they're changed in-place.
+    class Stepper {
+    public:
+        explicit Stepper(Ref<Term> term);
+
+        // returns false in normal form
+        bool step();
+        // returns the number of steps done
+        size_t step(size_t n);
+
+        bool normal_form() const { return !found; }
+        size_t get_steps() const { return steps; }
+
+        // for printing, valid until the next step
+        const Term& get_term() const { return *root; }
+        // The term is shared from now on,
+        // so the next step copies the path before changing it.
+        Ref<Term> share_term();
+
+        Stepper(const Stepper& o) = delete;
+        void operator=(const Stepper& o) = delete;
+    private:
+        enum Direction {
+            BODY,
+            LEFT,
+            RIGHT
+        };
+
+        static void make_unique(Ref<Term>& slot);
+        void descend(Direction direction);
+        // goes to the next right subterm, returns false if there's none
+        bool ascend_right();
+        // searches the focus and what follows it
+        void find_redex();
+        // makes the path unique again after share_term
+        void rebuild();
+
+        Ref<Term> root;
+        // slots[0] is &root, slots.back() holds the focus
+        std::vector<Ref<Term>*> slots;
+        // directions[i] leads from slots[i] to slots[i+1]
+        std::vector<Direction> directions;
+        // the focus is a redex
+        bool found = false;
+        bool shared = false;
+        size_t steps = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,70 @@
+#include "task.h"
+#include "flat.h"
+
+bool Lambda::EvalTask::resume() {
+    if (done())
+        return false;
+    handle.resume();
+    return !handle.done();
+}
+
+
+Lambda::Result& Lambda::EvalTask::result() {
+    assert(done());
+    if (handle.promise().exception)
+        std::rethrow_exception(handle.promise().exception);
+    return handle.promise().result;
+}
+
+
+namespace {
+    // lets the coroutine see its own promise
+    struct GetPromise {
+        Lambda::EvalTask::promise_type* promise;
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<Lambda::EvalTask::promise_type> h) noexcept {
+            promise = &h.promise();
+            return false;
+        }
+        Lambda::EvalTask::promise_type& await_resume() const noexcept { return *promise; }
+    };
+}
+
+
+Lambda::EvalTask Lambda::eval_task(Ref<Term> t, Options options, size_t slice) {
+    auto& promise = co_await GetPromise{};
+
+    // t is reduced in-place, so the previous term is kept in flat form.
+    Result result;
+    FlatTerm prev(*t), current;
+    while(true) {
+        if (options.max_steps != 0 && result.steps == options.max_steps) {
+            result.finished = false;
+            break;
+        }
+
+        if (slice != 0 && result.steps != 0 && result.steps % slice == 0) {
+            co_await std::suspend_always{};
+            if (promise.cancelled) {
+                result.finished = false;
+                result.cancelled = true;
+                break;
+            }
+        }
+
+        bool reduced;
+        std::tie(t, reduced) = step(std::move(t), options.strategy);
+        if (!reduced)
+            break;
+        result.steps++;
+
+        current.assign(*t);
+        if (options.observer)
+            options.observer(prev, current, result.steps);
+        if (current == prev)
+            break;
+        std::swap(prev, current);
+    }
+    result.term = std::move(t);
+    co_return result;
+}
@@ -0,0 +1,62 @@
+#ifndef TASK_H
+#define TASK_H
+
+#include <coroutine>
+#include <atomic>
+#include <exception>
+#include "lambda.h"
+
+namespace Lambda {
+    // A resumable evaluation, see eval_task.
+    // It doesn't start until the first resume().
+    class EvalTask {
+    public:
+        struct promise_type {
+            Result result;
+            std::exception_ptr exception;
+            std::atomic<bool> cancelled{false};
+
+            EvalTask get_return_object() {
+                return EvalTask(std::coroutine_handle<promise_type>::from_promise(*this));
+            }
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+            void return_value(Result r) { result = std::move(r); }
+            void unhandled_exception() { exception = std::current_exception(); }
+        };
+
+        EvalTask() = default;
+        EvalTask(EvalTask&& o) : handle{o.handle} { o.handle = nullptr; }
+        EvalTask& operator=(EvalTask&& o) {
+            std::swap(handle, o.handle);
+            return *this;
+        }
+        ~EvalTask() {
+            if (handle) handle.destroy();
+        }
+
+        // Runs one slice. Returns false when the evaluation is over.
+        bool resume();
+        bool done() const { return !handle || handle.done(); }
+
+        // Makes the task finish at its next slice. Can be called from any thread.
+        void cancel() { handle.promise().cancelled = true; }
+
+        // only when done()
+        // rethrows what the evaluation threw
+        Result& result();
+
+        EvalTask(const EvalTask& o) = delete;
+        void operator=(const EvalTask& o) = delete;
+    private:
+        explicit EvalTask(std::coroutine_handle<promise_type> handle) : handle{handle} {}
+
+        std::coroutine_handle<promise_type> handle;
+    };
+
+    // Evaluates like eval, but suspends after every 'slice' steps.
+    // 0 means it doesn't suspend.
+    EvalTask eval_task(Ref<Term> t, Options options, size_t slice);
+}
+
+#endif
@@ -1,76 +1,188 @@
 #include "term.h"
+#include "flat.h"
 
-//void Term::lift(std::shared_ptr<Term> term, size_t border, size_t distance) {
-//    if (term->get_type() == Term::VARIABLE) {
-//        auto t = std::static_pointer_cast<VariableTerm>(term);
-//        if (t->index >= border) {
-//            t->index += distance;
-//        }
-//    } else if (term->get_type() == Term::ABSTRACTION) {
-//        auto t = std::static_pointer_cast<AbstractionTerm>(term);
-//        lift(t->body, border+1, distance);
-//    } else { // if (Term::APPLICATION)
-//        auto t = std::static_pointer_cast<ApplicationTerm>(term);
-//        lift(t->left, border, distance);
-//        lift(t->right, border, distance);
-//    }
-//}
-//
-//std::shared_ptr<Term> 
-//Term::subst(std::shared_ptr<Term> term, size_t index, std::shared_ptr<Term> value, size_t lifting) {
-//    assert(value != nullptr);
-//    if (term->get_type() == Term::VARIABLE) {
-//        auto t = std::static_pointer_cast<VariableTerm>(term);
-//        if (t->index < index) {
-//            return t;
-//        }
-//        if (t->index > index) {
-//            t->index -= 1;
-//            return t;
-//        }
-//        Term::lift(value, 0, lifting);
-//        return value;
-//    } else if (term->get_type() == Term::ABSTRACTION) {
-//        auto t = std::static_pointer_cast<AbstractionTerm>(term);
-//        subst(t->body, index+1, value, lifting+1);
-//        return t;
-//    } else { // if (Term::APPLICATION)
-//        auto t = std::static_pointer_cast<ApplicationTerm>(term);
-//        subst(t->left, index, value, lifting);
-//        subst(t->right, index, value, lifting);
-//        return t;
-//    }
-//}
-//
-//std::pair<std::shared_ptr<Term>, bool> Term::beta_reduce(std::shared_ptr<Term> term) {
-//    if (term->get_type() == Term::VARIABLE) {
-//        auto t = std::static_pointer_cast<VariableTerm>(term);
-//        return {t, false};
-//    } else if (term->get_type() == Term::ABSTRACTION) {
-//        auto t = std::static_pointer_cast<AbstractionTerm>(term);
-//        bool reduced;
-//        std::tie(t->body, reduced) = beta_reduce(t->body);
-//        return {t, reduced};
-//    } else { // if (Term::APPLICATION)
-//        auto t = std::static_pointer_cast<ApplicationTerm>(term);
-//        if (t->left->get_type() == Term::ABSTRACTION) {
-//            auto left = std::static_pointer_cast<AbstractionTerm>(t->left);
-//            left->body = Term::subst(left->body, 0, t->right, 0);
-//            return {left->body, true};
-//        }
-//        bool left_reduced, right_reduced;
-//        std::tie(t->left, left_reduced) = beta_reduce(t->left);
-//        std::tie(t->right, right_reduced) = beta_reduce(t->right);
-//        return {t, left_reduced || right_reduced};
-//    }
-//}
-//
-///*
-//    if (term->get_type() == Term::VARIABLE) {
-//        auto t = std::static_pointer_cast<VariableTerm>(term);
-//    } else if (term->get_type() == Term::ABSTRACTION) {
-//        auto t = std::static_pointer_cast<AbstractionTerm>(term);
-//    } else { // if (Term::APPLICATION)
-//        auto t = std::static_pointer_cast<ApplicationTerm>(term);
-//    }
-//*/
+bool Term::alpha_equivalent(const Term& other) const {
+    return FlatTerm(*this) == FlatTerm(other);
+}
+
+size_t Term::hash() const {
+    return FlatTerm(*this).hash();
+}
+
+// When a node is unique its children are moved out before recursing,
+// so their counts tell whether they are unique too.
+// Children of a shared node are passed as copies, so they are never changed.
+
+Ref<Term> Term::lift(Ref<Term> term, size_t border, size_t distance) {
+    if (distance == 0)
+        return term;
+
+    if (term->get_type() == Term::VARIABLE) {
+        auto t = static_cast<VariableTerm*>(term.get());
+        if (t->index < border)
+            return term;
+        if (term.unique()) {
+            t->index += distance;
+            return term;
+        }
+        return make_ref<VariableTerm>(t->index + distance);
+    } else if (term->get_type() == Term::ABSTRACTION) {
+        auto t = static_cast<AbstractionTerm*>(term.get());
+        if (term.unique()) {
+            t->body = lift(std::move(t->body), border+1, distance);
+            return term;
+        }
+        auto body = lift(t->body, border+1, distance);
+        if (body == t->body)
+            return term;
+        return make_ref<AbstractionTerm>(std::move(body));
+    } else { // if (Term::APPLICATION)
+        auto t = static_cast<ApplicationTerm*>(term.get());
+        if (term.unique()) {
+            t->left = lift(std::move(t->left), border, distance);
+            t->right = lift(std::move(t->right), border, distance);
+            return term;
+        }
+        auto left = lift(t->left, border, distance);
+        auto right = lift(t->right, border, distance);
+        if (left == t->left && right == t->right)
+            return term;
+        return make_ref<ApplicationTerm>(std::move(left), std::move(right));
+    }
+}
+
+Ref<Term>
+Term::subst(Ref<Term> term, size_t index, const Ref<Term>& value, size_t lifting) {
+    assert(value != nullptr);
+    if (term->get_type() == Term::VARIABLE) {
+        auto t = static_cast<VariableTerm*>(term.get());
+        if (t->index < index)
+            return term;
+        if (t->index > index) {
+            if (term.unique()) {
+                t->index -= 1;
+                return term;
+            }
+            return make_ref<VariableTerm>(t->index - 1);
+        }
+        return lift(value, 0, lifting);
+    } else if (term->get_type() == Term::ABSTRACTION) {
+        auto t = static_cast<AbstractionTerm*>(term.get());
+        if (term.unique()) {
+            t->body = subst(std::move(t->body), index+1, value, lifting+1);
+            return term;
+        }
+        auto body = subst(t->body, index+1, value, lifting+1);
+        if (body == t->body)
+            return term;
+        return make_ref<AbstractionTerm>(std::move(body));
+    } else { // if (Term::APPLICATION)
+        auto t = static_cast<ApplicationTerm*>(term.get());
+        if (term.unique()) {
+            t->left = subst(std::move(t->left), index, value, lifting);
+            t->right = subst(std::move(t->right), index, value, lifting);
+            return term;
+        }
+        auto left = subst(t->left, index, value, lifting);
+        auto right = subst(t->right, index, value, lifting);
+        if (left == t->left && right == t->right)
+            return term;
+        return make_ref<ApplicationTerm>(std::move(left), std::move(right));
+    }
+}
+
+Ref<Term> Term::contract(Ref<Term> redex) {
+    assert(redex->get_type() == Term::APPLICATION);
+    auto t = static_cast<ApplicationTerm*>(redex.get());
+    assert(t->left->get_type() == Term::ABSTRACTION);
+
+    Ref<Term> left, right;
+    if (redex.unique()) {
+        left = std::move(t->left);
+        right = std::move(t->right);
+        redex.reset();
+    } else {
+        left = t->left;
+        right = t->right;
+    }
+    auto abstraction = static_cast<AbstractionTerm*>(left.get());
+    Ref<Term> body;
+    if (left.unique())
+        body = std::move(abstraction->body);
+    else
+        body = abstraction->body;
+    left.reset();
+    return subst(std::move(body), 0, right, 0);
+}
+
+std::pair<Ref<Term>, bool> Term::beta_reduce(Ref<Term> term) {
+    if (term->get_type() == Term::VARIABLE) {
+        return {std::move(term), false};
+    } else if (term->get_type() == Term::ABSTRACTION) {
+        auto t = static_cast<AbstractionTerm*>(term.get());
+        bool reduced;
+        if (term.unique()) {
+            std::tie(t->body, reduced) = beta_reduce(std::move(t->body));
+            return {std::move(term), reduced};
+        }
+        Ref<Term> body;
+        std::tie(body, reduced) = beta_reduce(t->body);
+        if (!reduced)
+            return {std::move(term), false};
+        return {make_ref<AbstractionTerm>(std::move(body)), true};
+    } else { // if (Term::APPLICATION)
+        auto t = static_cast<ApplicationTerm*>(term.get());
+        if (t->left->get_type() == Term::ABSTRACTION)
+            return {contract(std::move(term)), true};
+        bool left_reduced, right_reduced;
+        if (term.unique()) {
+            std::tie(t->left, left_reduced) = beta_reduce(std::move(t->left));
+            std::tie(t->right, right_reduced) = beta_reduce(std::move(t->right));
+            return {std::move(term), left_reduced || right_reduced};
+        }
+        Ref<Term> left, right;
+        std::tie(left, left_reduced) = beta_reduce(t->left);
+        std::tie(right, right_reduced) = beta_reduce(t->right);
+        if (!left_reduced && !right_reduced)
+            return {std::move(term), false};
+        return {make_ref<ApplicationTerm>(std::move(left), std::move(right)), true};
+    }
+}
+
+std::pair<Ref<Term>, bool> Term::reduce_leftmost(Ref<Term> term) {
+    if (term->get_type() == Term::VARIABLE) {
+        return {std::move(term), false};
+    } else if (term->get_type() == Term::ABSTRACTION) {
+        auto t = static_cast<AbstractionTerm*>(term.get());
+        bool reduced;
+        if (term.unique()) {
+            std::tie(t->body, reduced) = reduce_leftmost(std::move(t->body));
+            return {std::move(term), reduced};
+        }
+        Ref<Term> body;
+        std::tie(body, reduced) = reduce_leftmost(t->body);
+        if (!reduced)
+            return {std::move(term), false};
+        return {make_ref<AbstractionTerm>(std::move(body)), true};
+    } else { // if (Term::APPLICATION)
+        auto t = static_cast<ApplicationTerm*>(term.get());
+        if (t->left->get_type() == Term::ABSTRACTION)
+            return {contract(std::move(term)), true};
+
+        bool reduced;
+        if (term.unique()) {
+            std::tie(t->left, reduced) = reduce_leftmost(std::move(t->left));
+            if (!reduced)
+                std::tie(t->right, reduced) = reduce_leftmost(std::move(t->right));
+            return {std::move(term), reduced};
+        }
+        Ref<Term> left, right;
+        std::tie(left, reduced) = reduce_leftmost(t->left);
+        if (reduced)
+            return {make_ref<ApplicationTerm>(std::move(left), t->right), true};
+        std::tie(right, reduced) = reduce_leftmost(t->right);
+        if (reduced)
+            return {make_ref<ApplicationTerm>(t->left, std::move(right)), true};
+        return {std::move(term), false};
+    }
+}
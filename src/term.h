@@ -3,9 +3,9 @@
 
 #include <iostream>
 #include <string>
-#include <memory>
 #include <cassert>
 #include "context.h"
+#include "ref.h"
 #include <utility>
 
 //#define TERM_PRINT_ALL_PAREN
@@ -19,29 +19,32 @@ public:
     };
 private:
     Type type;
+    template <class T> friend class Ref;
+    mutable size_t refcount = 0;
 protected:
     Term(Type type) : type{type} {}
 public:
-    Type get_type() const { return type; }
-
-    virtual bool alpha_equivalent(std::shared_ptr<Term> other) const = 0;
+    virtual ~Term() = default;
 
-    // these make changed copies
-    virtual std::shared_ptr<Term> lift(size_t border, size_t distance) const = 0;
-    virtual std::shared_ptr<Term>
-    subst(size_t index, std::shared_ptr<Term> value, size_t lifting) const = 0;
-    virtual std::shared_ptr<Term> beta_reduce() const = 0;
-    
+    Type get_type() const { return type; }
 
-    // This didn't work
-    //// these work in-place
-    //static void lift(std::shared_ptr<Term> term, size_t border, size_t distance);
-    //// returns new_expression
-    //static std::shared_ptr<Term> 
-    //    subst(std::shared_ptr<Term> term, size_t index, std::shared_ptr<Term> value, size_t lifting);
-    //// returns {new_expression, reduced}
-    //// reduction to itself counts too
-    //static std::pair<std::shared_ptr<Term>, bool> beta_reduce(std::shared_ptr<Term> term);
+    // these compare and hash the flat encoding (see flat.h)
+    bool alpha_equivalent(const Term& other) const;
+    size_t hash() const;
+
+    // These consume the term. Nodes that are only referenced by 'term'
+    // are changed in-place, shared nodes are copied (or reused if nothing changes).
+    static Ref<Term> lift(Ref<Term> term, size_t border, size_t distance);
+    static Ref<Term>
+    subst(Ref<Term> term, size_t index, const Ref<Term>& value, size_t lifting);
+    // term must be an application of an abstraction
+    static Ref<Term> contract(Ref<Term> redex);
+    // contracts every outermost redex
+    // returns {new_expression, reduced}
+    // reduction to itself counts too
+    static std::pair<Ref<Term>, bool> beta_reduce(Ref<Term> term);
+    // contracts the leftmost outermost redex
+    static std::pair<Ref<Term>, bool> reduce_leftmost(Ref<Term> term);
 
 
     virtual void print(std::ostream& out, const Context& context, size_t distance) const = 0;
@@ -56,35 +59,6 @@ class VariableTerm : public Term {
 public:
     VariableTerm(size_t index) : Term(VARIABLE), index{index} {}
 
-    bool alpha_equivalent(std::shared_ptr<Term> other) const {
-        assert(other != nullptr);
-        if (other->get_type() != get_type()) return false;
-
-        auto other_ = std::static_pointer_cast<VariableTerm>(other);
-
-        return index == other_->index;
-    }
-
-    std::shared_ptr<Term> lift(size_t border, size_t distance) const override {
-        if (index >= border)
-            return std::make_shared<VariableTerm>(index + distance);
-        return std::make_shared<VariableTerm>(index);
-    }
-
-    std::shared_ptr<Term> 
-    subst(size_t index, std::shared_ptr<Term> value, size_t lifting) const override {
-        assert(value != nullptr);
-        if (this->index < index)
-            return std::make_shared<VariableTerm>(this->index);
-        if (this->index > index)
-            return std::make_shared<VariableTerm>(this->index-1);
-        return value->lift(0, lifting);
-    }
-
-    std::shared_ptr<Term> beta_reduce() const override {
-        return std::make_shared<VariableTerm>(index);
-    }
-
     void print(std::ostream& out, const Context& context, size_t distance) const override {
         if (index >= distance)
             //out << "'";
@@ -100,36 +74,11 @@ public:
 
 class AbstractionTerm : public Term {
 public:
-    AbstractionTerm(std::shared_ptr<Term> body) : 
+    AbstractionTerm(Ref<Term> body) : 
         Term(ABSTRACTION),
-        body{body}
+        body{std::move(body)}
     {
-        assert(body != nullptr);
-    }
-
-    bool alpha_equivalent(std::shared_ptr<Term> other) const {
-        assert(other != nullptr);
-        if (other->get_type() != get_type()) return false;
-
-        auto other_ = std::static_pointer_cast<AbstractionTerm>(other);
-
-        return body->alpha_equivalent(other_->body);
-    }
-
-    std::shared_ptr<Term> lift(size_t border, size_t distance) const override {
-        auto body_ = body->lift(border+1, distance);
-        return std::make_shared<AbstractionTerm>(body_);
-    }
-
-    std::shared_ptr<Term> 
-    subst(size_t index, std::shared_ptr<Term> value, size_t lifting) const override {
-        assert(value != nullptr);
-        auto body_ = body->subst(index+1, value, lifting+1);
-        return std::make_shared<AbstractionTerm>(body_);
-    }
-
-    std::shared_ptr<Term> beta_reduce() const override {
-        return std::make_shared<AbstractionTerm>(body->beta_reduce());
+        assert(this->body != nullptr);
     }
 
     void print(std::ostream& out, const Context& context, size_t distance) const override {
@@ -148,48 +97,17 @@ public:
 #endif
     }
 
-    std::shared_ptr<Term> body;
+    Ref<Term> body;
 };
 
 
 class ApplicationTerm : public Term {
 public:
-    ApplicationTerm(std::shared_ptr<Term> left, std::shared_ptr<Term> right) : 
-        Term(APPLICATION), left{left}, right{right}
+    ApplicationTerm(Ref<Term> left, Ref<Term> right) : 
+        Term(APPLICATION), left{std::move(left)}, right{std::move(right)}
     {
-        assert(left != nullptr);
-        assert(right != nullptr);
-    }
-
-    bool alpha_equivalent(std::shared_ptr<Term> other) const {
-        assert(other != nullptr);
-        if (other->get_type() != get_type()) return false;
-
-        auto other_ = std::static_pointer_cast<ApplicationTerm>(other);
-
-        return left->alpha_equivalent(other_->left) && right->alpha_equivalent(other_->right);
-    }
-
-    std::shared_ptr<Term> lift(size_t border, size_t distance) const override {
-        auto left_ = left->lift(border, distance);
-        auto right_ = right->lift(border, distance);
-        return std::make_shared<ApplicationTerm>(left_, right_);
-    }
-
-    std::shared_ptr<Term> 
-    subst(size_t index, std::shared_ptr<Term> value, size_t lifting) const override {
-        assert(value != nullptr);
-        auto left_ = left->subst(index, value, lifting);
-        auto right_ = right->subst(index, value, lifting);
-        return std::make_shared<ApplicationTerm>(left_, right_);
-    }
-
-    std::shared_ptr<Term> beta_reduce() const override {
-        if (left->get_type() == ABSTRACTION) {
-            auto left_ = std::static_pointer_cast<AbstractionTerm>(left);
-            return left_->body->subst(0, right, 0);
-        }
-        return std::make_shared<ApplicationTerm>(left->beta_reduce(), right->beta_reduce());
+        assert(this->left != nullptr);
+        assert(this->right != nullptr);
     }
 
     void print(std::ostream& out, const Context& context, size_t distance) const override {
@@ -211,7 +129,7 @@ public:
         if (right_paren) out << ')';
     }
 
-    std::shared_ptr<Term> left, right;
+    Ref<Term> left, right;
 };
 
 
@@ -0,0 +1,502 @@
+#include "trace.h"
+#include <algorithm>
+#include <map>
+#include <stdexcept>
+#include <iomanip>
+
+// Trace format: the header, then records.
+// Numbers are LEB128 varints, a record starts with its type.
+//     header: "LMTR", version, strategy
+//     STEP: evaluation, step, size before, size after,
+//           redexes, recorded, recorded * (offset, size, site),
+//           counted, counted * (site, redexes, size) for the rest
+//     SITE: site, abstraction hash, abstraction size, code length (0 or its size), code
+//     DROPPED: steps
+//     RESTART: a resumed run continues the trace,
+//              evaluations and sites are numbered from the start again
+namespace {
+    const char magic[4] = {'L', 'M', 'T', 'R'};
+    const uint64_t version = 2;
+
+    enum : uint64_t {
+        STEP = 1,
+        SITE = 2,
+        DROPPED = 3,
+        RESTART = 4
+    };
+
+    const size_t chunk_size = 1 << 16;
+    const size_t chunks = 8;
+    // a chunk that isn't full is written after this long
+    const auto submit_interval = std::chrono::seconds(1);
+    // redexes with an offset per step, so a step's records fit in about a chunk
+    const size_t max_redexes = 256;
+    // longer abstractions are recorded without their code
+    const size_t max_site_code = 256;
+
+
+    // a trace whose run was killed can end in the middle of a record
+    struct Truncated : std::runtime_error {
+        Truncated() : std::runtime_error("Unexpected end of trace") {}
+    };
+
+    uint64_t read_number(std::istream& in) {
+        uint64_t n = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            int c = in.get();
+            if (c == EOF)
+                throw Truncated();
+            n |= uint64_t(c & 0x7f) << shift;
+            if (!(c & 0x80))
+                return n;
+        }
+        throw std::runtime_error("Malformed trace");
+    }
+
+    uint64_t hash_code(const uint32_t* begin, size_t size) {
+        uint64_t h = 0xcbf29ce484222325ull ^ size;
+        for (size_t i = 0; i < size; ++i)
+            h = (h ^ begin[i]) * 0x100000001b3ull;
+        return h;
+    }
+}
+
+
+Lambda::TraceRecorder::TraceRecorder(const std::string& path, Strategy strategy, bool append) :
+    strategy{strategy}
+{
+    // an empty or missing file gets a header, like a new trace
+    bool restart = false;
+    if (append) {
+        std::ifstream existing(path, std::ios::binary);
+        char m[sizeof(magic)];
+        if (existing.read(m, sizeof(m))) {
+            if (!std::equal(m, m + sizeof(m), magic))
+                throw std::runtime_error("'" + path + "' isn't a trace");
+            restart = true;
+        }
+    }
+
+    out.open(path, std::ios::binary | (restart ? std::ios::app : std::ios::trunc));
+    if (!out.good())
+        throw std::runtime_error("Couldn't open '" + path + "'");
+
+    for (size_t i = 1; i < chunks; ++i) {
+        free.emplace_back();
+        free.back().reserve(chunk_size);
+    }
+    chunk.reserve(chunk_size);
+
+    // the header goes through the writer like everything else
+    if (restart) {
+        put(RESTART);
+    } else {
+        chunk.insert(chunk.end(), magic, magic + sizeof(magic));
+        put(version);
+        put(strategy);
+    }
+
+    next_submit = std::chrono::steady_clock::now() + submit_interval;
+    writer = std::thread(&TraceRecorder::work, this);
+}
+
+
+Lambda::TraceRecorder::~TraceRecorder() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (dropped > 0) {
+            put(DROPPED);
+            put(dropped);
+        }
+        full.push_back(std::move(chunk));
+        stopping = true;
+    }
+    changed.notify_one();
+    writer.join();
+
+    out.flush();
+    if (!out.good())
+        std::cerr << "Couldn't write the trace" << std::endl;
+}
+
+
+void Lambda::TraceRecorder::put(uint64_t n) {
+    while (n >= 0x80) {
+        chunk.push_back(uint8_t(n) | 0x80);
+        n >>= 7;
+    }
+    chunk.push_back(uint8_t(n));
+}
+
+
+size_t Lambda::TraceRecorder::site_of(const uint32_t* abstraction, size_t size) {
+    uint64_t h = hash_code(abstraction, size);
+    auto [it, added] = sites.insert({h, {sites.size(), false}});
+    if (!it->second.written) {
+        bool code = size <= max_site_code;
+        put(SITE);
+        put(it->second.id);
+        put(h);
+        put(size);
+        put(code ? size : 0);
+        if (code) {
+            for (size_t i = 0; i < size; ++i)
+                put(abstraction[i]);
+        }
+        it->second.written = true;
+        chunk_sites.push_back(h);
+    }
+    return it->second.id;
+}
+
+
+void Lambda::TraceRecorder::record(const FlatTerm& before, const FlatTerm& after, size_t steps) {
+    if (evaluation == 0 || steps != last_steps + 1)
+        evaluation++;
+    last_steps = steps;
+
+    // The redexes the step contracted: the outermost ones for PARALLEL,
+    // only the first (leftmost outermost) for NORMAL.
+    // The first max_redexes are recorded one by one, the rest by site.
+    const uint32_t* begin = before.data().data();
+    const uint32_t* end = begin + before.size();
+    size_t count = 0;
+    redexes.clear();
+    for (const uint32_t* p = begin; p + 1 < end;) {
+        if (p[0] != FlatTerm::APPLICATION || p[1] != FlatTerm::ABSTRACTION) {
+            p++;
+            continue;
+        }
+
+        size_t size = FlatTerm::subterm_size(p, end);
+        size_t site = site_of(p + 1, FlatTerm::subterm_size(p + 1, end));
+        if (count++ < max_redexes) {
+            redexes.push_back({size_t(p - begin), size, site});
+        } else {
+            if (site >= counts.size())
+                counts.resize(site + 1);
+            if (counts[site].contractions++ == 0)
+                counted.push_back(site);
+            counts[site].nodes += size;
+        }
+
+        if (strategy == NORMAL)
+            break;
+        p += size;
+    }
+
+    put(STEP);
+    put(evaluation);
+    put(steps);
+    put(before.size());
+    put(after.size());
+    put(count);
+    put(redexes.size());
+    for (auto& redex : redexes) {
+        put(redex.offset);
+        put(redex.size);
+        put(redex.site);
+    }
+    put(counted.size());
+    for (size_t site : counted) {
+        put(site);
+        put(counts[site].contractions);
+        put(counts[site].nodes);
+        counts[site] = {};
+    }
+    counted.clear();
+
+    chunk_steps++;
+    if (chunk.size() >= chunk_size || std::chrono::steady_clock::now() >= next_submit)
+        submit();
+}
+
+
+void Lambda::TraceRecorder::submit() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (free.empty()) {
+            // The writer is behind, waiting for it would slow down the evaluation.
+            dropped += chunk_steps;
+            dropped_total += chunk_steps;
+            for (uint64_t h : chunk_sites)
+                sites[h].written = false;
+            chunk.clear();
+        } else {
+            if (dropped > 0) {
+                put(DROPPED);
+                put(dropped);
+                dropped = 0;
+            }
+            full.push_back(std::move(chunk));
+            chunk = std::move(free.back());
+            free.pop_back();
+        }
+    }
+    changed.notify_one();
+    chunk_steps = 0;
+    chunk_sites.clear();
+    next_submit = std::chrono::steady_clock::now() + submit_interval;
+}
+
+
+void Lambda::TraceRecorder::work() {
+    while (true) {
+        std::vector<uint8_t> c;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            changed.wait(lock, [&]() { return stopping || !full.empty(); });
+            if (full.empty())
+                return;
+            c = std::move(full.front());
+            full.pop_front();
+        }
+
+        // flushed, so the trace of a run that is killed is still useful
+        out.write(reinterpret_cast<const char*>(c.data()), c.size());
+        out.flush();
+
+        c.clear();
+        std::lock_guard<std::mutex> lock(mutex);
+        free.push_back(std::move(c));
+    }
+}
+
+
+namespace {
+    // kept per evaluation, before it's halved
+    const size_t max_samples = 64;
+
+    struct Evaluation {
+        size_t steps = 0;
+        size_t redexes = 0;
+        size_t max_size = 0;
+        size_t max_step = 0;
+        // {step, size after it}, every stride-th of them,
+        // starting with the size before the first step
+        std::vector<std::pair<size_t, size_t>> sizes;
+        size_t stride = 1;
+        size_t seen = 0;
+        std::pair<size_t, size_t> last;
+
+        void add(size_t step, size_t size) {
+            last = {step, size};
+            if (size > max_size || seen == 0) {
+                max_size = size;
+                max_step = step;
+            }
+            if (seen++ % stride != 0)
+                return;
+            sizes.push_back(last);
+            // when it's full every other sample goes, the rest stay evenly spaced
+            if (sizes.size() == max_samples) {
+                for (size_t i = 0; i < max_samples / 2; ++i)
+                    sizes[i] = sizes[2 * i];
+                sizes.resize(max_samples / 2);
+                stride *= 2;
+            }
+        }
+    };
+
+    struct Site {
+        size_t size = 0;
+        std::vector<uint32_t> code;
+        size_t contractions = 0;
+        // sizes of its redexes
+        size_t nodes = 0;
+    };
+
+    std::string site_string(const Site& site) {
+        if (site.code.empty())
+            return "(" + std::to_string(site.size) + " nodes)";
+
+        // free variables don't have their names in the trace
+        uint32_t max_word = *std::max_element(site.code.begin(), site.code.end());
+        if (max_word - FlatTerm::VARIABLE >= max_site_code)
+            return "(" + std::to_string(site.size) + " nodes)";
+        Context context;
+        for (uint32_t i = FlatTerm::VARIABLE; i <= max_word; ++i)
+            context.push_identifier("?" + std::to_string(i - FlatTerm::VARIABLE));
+
+        std::string s = Lambda::to_string(*FlatTerm(site.code).to_term(), context);
+        const size_t width = 60;
+        if (s.size() > width)
+            s = s.substr(0, width - 3) + "...";
+        return s;
+    }
+}
+
+
+void Lambda::analyze_trace(std::istream& in, std::ostream& out) {
+    char m[sizeof(magic)];
+    if (!in.read(m, sizeof(m)) || !std::equal(m, m + sizeof(m), magic))
+        throw std::runtime_error("Not a trace");
+    if (read_number(in) != version)
+        throw std::runtime_error("Unsupported trace version");
+    uint64_t strategy = read_number(in);
+
+    std::map<size_t, Evaluation> evaluations;
+    // by hash, the runs of a resumed trace number them differently
+    std::unordered_map<uint64_t, Site> sites;
+    // site_base + site -> hash
+    std::map<size_t, uint64_t> site_hashes;
+    size_t steps = 0, redexes = 0, recorded_redexes = 0, dropped = 0, repeated = 0;
+    bool truncated = false;
+
+    // after a RESTART: numbers are offset, and a first step that isn't
+    // step 1 continues the last evaluation (it was resumed in the middle)
+    size_t evaluation_base = 0, site_base = 0;
+    bool restarted = false;
+
+    auto site = [&](size_t id) -> Site& {
+        auto it = site_hashes.find(site_base + id);
+        if (it == site_hashes.end())
+            throw std::runtime_error("Malformed trace");
+        return sites[it->second];
+    };
+
+
+    try {
+        while (in.peek() != EOF) {
+            uint64_t type = read_number(in);
+            if (type == STEP) {
+                size_t number = read_number(in);
+                size_t step = read_number(in);
+                size_t before = read_number(in);
+                size_t after = read_number(in);
+                size_t count = read_number(in);
+                size_t recorded = read_number(in);
+                if (recorded > count || recorded > max_redexes || step == 0)
+                    throw std::runtime_error("Malformed trace");
+
+                if (restarted) {
+                    size_t last = evaluations.empty() ? 0 : evaluations.rbegin()->first;
+                    evaluation_base = step > 1 && last > 0 ? last - 1 : last;
+                    restarted = false;
+                }
+                auto& evaluation = evaluations[evaluation_base + number];
+
+                // The killed run can have gone further than its checkpoint,
+                // the resumed run repeats those steps.
+                bool repeat = evaluation.seen > 0 && step <= evaluation.last.first;
+                if (repeat) {
+                    repeated++;
+                } else {
+                    if (evaluation.seen == 0)
+                        evaluation.add(step - 1, before);
+                    evaluation.add(step, after);
+                    evaluation.steps++;
+                    evaluation.redexes += count;
+                    steps++;
+                    redexes += count;
+                    recorded_redexes += recorded;
+                }
+
+                for (size_t i = 0; i < recorded; ++i) {
+                    read_number(in); // offset
+                    size_t size = read_number(in);
+                    auto& s = site(read_number(in));
+                    if (!repeat) {
+                        s.contractions++;
+                        s.nodes += size;
+                    }
+                }
+                size_t counted = read_number(in);
+                for (size_t i = 0; i < counted; ++i) {
+                    auto& s = site(read_number(in));
+                    size_t contractions = read_number(in);
+                    size_t nodes = read_number(in);
+                    if (!repeat) {
+                        s.contractions += contractions;
+                        s.nodes += nodes;
+                    }
+                }
+            } else if (type == SITE) {
+                size_t id = read_number(in);
+                uint64_t hash = read_number(in);
+                size_t size = read_number(in);
+                size_t length = read_number(in);
+                if (length != 0 && (length != size || length > max_site_code))
+                    throw std::runtime_error("Malformed trace");
+                std::vector<uint32_t> code(length);
+                for (auto& word : code) {
+                    uint64_t n = read_number(in);
+                    if (n > UINT32_MAX)
+                        throw std::runtime_error("Malformed trace");
+                    word = n;
+                }
+                if (length != 0 && FlatTerm::subterm_size(code.data(), code.data() + length) != length)
+                    throw std::runtime_error("Malformed trace");
+
+                site_hashes[site_base + id] = hash;
+                auto& s = sites[hash];
+                s.size = size;
+                s.code = std::move(code);
+            } else if (type == DROPPED) {
+                dropped += read_number(in);
+            } else if (type == RESTART) {
+                site_base = site_hashes.empty() ? 0 : site_hashes.rbegin()->first + 1;
+                restarted = true;
+            } else {
+                throw std::runtime_error("Malformed trace");
+            }
+        }
+    } catch (const Truncated& e) {
+        truncated = true;
+    }
+
+    out << steps << " steps (" << (strategy == NORMAL ? "normal" : "parallel") << ") in "
+        << evaluations.size() << " evaluations, " << redexes << " redexes contracted";
+    if (recorded_redexes != redexes)
+        out << " (" << recorded_redexes << " with offsets)";
+    out << std::endl;
+    if (truncated)
+        out << "the trace ends in the middle of a record" << std::endl;
+    if (dropped > 0)
+        out << dropped << " steps were dropped" << std::endl;
+    if (repeated > 0)
+        out << repeated << " steps were repeated by a resumed run and are counted once" << std::endl;
+
+    // growth curves, sampled at about this many steps
+    const size_t samples = 8;
+    for (auto& [number, evaluation] : evaluations) {
+        auto& sizes = evaluation.sizes;
+        out << std::endl;
+        out << "evaluation " << number << ": " << evaluation.steps << " steps, "
+            << evaluation.redexes << " redexes, size " << sizes.front().second
+            << " -> " << evaluation.last.second << ", max " << evaluation.max_size
+            << " after step " << evaluation.max_step << std::endl;
+        out << "    step:size";
+        size_t stride = std::max<size_t>(1, (sizes.size() + samples - 1) / samples);
+        for (size_t i = 0; i < sizes.size(); i += stride)
+            out << " " << sizes[i].first << ":" << sizes[i].second;
+        // the last one is always shown
+        if (evaluation.last != sizes[(sizes.size() - 1) / stride * stride])
+            out << " " << evaluation.last.first << ":" << evaluation.last.second;
+        out << std::endl;
+    }
+
+    std::vector<Site> hot;
+    for (auto& [hash, site] : sites) {
+        if (site.contractions > 0)
+            hot.push_back(std::move(site));
+    }
+
+    const size_t shown = 10;
+    size_t total = hot.size();
+    std::partial_sort(hot.begin(), hot.begin() + std::min(shown, hot.size()), hot.end(),
+        [](auto& a, auto& b) {
+            if (a.contractions != b.contractions)
+                return a.contractions > b.contractions;
+            return a.nodes > b.nodes;
+        });
+    hot.resize(std::min(shown, hot.size()));
+
+    out << std::endl;
+    out << "hot redex sites (" << total << " sites):" << std::endl;
+    out << std::setw(12) << "contractions" << std::setw(12) << "nodes" << "  abstraction" << std::endl;
+    for (auto& site : hot) {
+        out << std::setw(12) << site.contractions << std::setw(12) << site.nodes
+            << "  " << site_string(site) << std::endl;
+    }
+}
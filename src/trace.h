@@ -0,0 +1,116 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "lambda.h"
+#include "flat.h"
+
+namespace Lambda {
+    // Writes a binary trace of the reductions to a file, for analyze_trace.
+    // Use it as the observer of Options:
+    //     TraceRecorder trace("run.trace", options.strategy);
+    //     options.observer = [&](auto& before, auto& after, size_t steps) {
+    //         trace.record(before, after, steps);
+    //     };
+    //
+    // Every step records the term's size before and after it, and every
+    // contracted redex its offset in the term before (in prefix order, see
+    // FlatTerm), its size and its site: the abstraction that was applied.
+    // Redexes of the same abstraction have the same site, the code of a site
+    // is recorded the first time it's seen. Past a few hundred redexes in a
+    // step only the number of redexes of each site is recorded.
+    //
+    // Records are written to a few fixed size chunks, the full ones (and every
+    // second the current one) are written to the file on a background thread. If the thread falls behind, a chunk
+    // is dropped instead of waiting, and the number of steps in it is recorded.
+    //
+    // Not thread-safe, one evaluation at a time.
+    class TraceRecorder {
+    public:
+        // append continues the trace in path (of a run that is resumed)
+        // throws std::runtime_error if path can't be written or isn't a trace
+        TraceRecorder(const std::string& path, Strategy strategy, bool append = false);
+        // writes the rest of the trace before returning
+        ~TraceRecorder();
+
+        // A step whose number doesn't follow the previous one starts a new evaluation.
+        void record(const FlatTerm& before, const FlatTerm& after, size_t steps);
+
+        size_t get_dropped() const { return dropped_total; }
+
+        TraceRecorder(const TraceRecorder& o) = delete;
+        void operator=(const TraceRecorder& o) = delete;
+    private:
+        void put(uint64_t n);
+        // writes the site's record if it wasn't
+        size_t site_of(const uint32_t* abstraction, size_t size);
+        // hands the current chunk to the writer
+        void submit();
+        void work();
+
+        Strategy strategy;
+        std::ofstream out;
+
+        std::vector<uint8_t> chunk;
+        // steps in chunk, counted as dropped if it is
+        size_t chunk_steps = 0;
+        // so a killed run leaves most of its trace
+        std::chrono::steady_clock::time_point next_submit;
+        size_t dropped = 0;
+        size_t dropped_total = 0;
+
+        size_t evaluation = 0;
+        size_t last_steps = 0;
+
+        struct Site {
+            size_t id;
+            // false until its record is written, and if that was dropped
+            bool written;
+        };
+        // abstraction hash -> site
+        std::unordered_map<uint64_t, Site> sites;
+        // sites written to chunk, to write again if it's dropped
+        std::vector<uint64_t> chunk_sites;
+
+        struct Redex {
+            size_t offset;
+            size_t size;
+            size_t site;
+        };
+        // scratch, the redexes of a step
+        std::vector<Redex> redexes;
+
+        // scratch, by site, of the redexes of a step that aren't in 'redexes'
+        struct Count {
+            size_t contractions = 0;
+            size_t nodes = 0;
+        };
+        std::vector<Count> counts;
+        std::vector<size_t> counted;
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<std::vector<uint8_t>> full;
+        std::vector<std::vector<uint8_t>> free;
+        bool stopping = false;
+        std::thread writer;
+    };
+
+    // Prints a summary of a trace: every evaluation's growth curve
+    // and the sites with the most contractions.
+    // Memory doesn't grow with the number of steps, only with the number
+    // of evaluations and sites.
+    // Throws std::runtime_error on malformed input.
+    void analyze_trace(std::istream& in, std::ostream& out);
+}
+
+#endif